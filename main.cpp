@@ -8,32 +8,211 @@
 #include <sstream>
 #include <cctype>
 #include <queue>
+#include <deque>
+#include <random>
 #include <map>
+#include <tuple>
+#include <unordered_map>
+#include <cstdint>
 
 #include <memory>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <string_view>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
 // ===================== DATA STRUCTURES =====================
+// Seat names such as "C7" (column letter + row number) are parsed once into
+// a SeatCode, which means the same seat on every aircraft. A flight's seat
+// layout numbers the seats it actually has densely (see SEAT LAYOUTS), and
+// seat state is kept per SeatIndex, so it never needs string keys.
+const int SEAT_LETTERS = 26;
+const int MAX_SEAT_ROWS = 99;
+const int MAX_SEATS = 512;
+const int SEAT_WORDS = MAX_SEATS / 64;
+
+typedef uint16_t SeatCode;  // (row - 1) * SEAT_LETTERS + letter
+typedef uint16_t SeatIndex; // position in a layout's seat tables
+const SeatCode INVALID_SEAT = 0xFFFF;
+const SeatIndex NO_SEAT = 0xFFFF;
+
+// Attributes of a seat in a layout
+const uint8_t SEAT_WINDOW = 1;
+const uint8_t SEAT_AISLE = 2;
+const uint8_t SEAT_EXIT_ROW = 4;
+
+// A run of rows with the same seats across, e.g. rows 4-29 "ABC|DEF"
+// in economy. '|' marks an aisle.
+struct CabinSection {
+    char cabin; // 'F'irst, 'J' business, 'W' premium economy, 'Y' economy
+    int firstRow, lastRow;
+    const char* seats;
+};
+
+// Aircraft whose standard layout is also built at compile time (see SEAT
+// LAYOUTS). Layouts of every other model only exist at run time.
+enum class FleetModel : uint8_t { None, Boeing737, AirbusA320 };
+
+// How an aircraft model's seats are arranged, as written by hand
+struct LayoutDefinition {
+    const char* model;
+    vector<CabinSection> sections;
+    vector<int> exitRows;
+    vector<SeatCode> blocked; // seats the sections would create but that do not exist
+    FleetModel fleet = FleetModel::None;
+};
+
+// The seat tables of a FleetModel's layout, computed by the compiler.
+// Seats are numbered exactly as compileLayout numbers them, so a flight's
+// seat bitmap means the same under either form of its layout.
+template <int Rows>
+struct FleetLayout {
+    static constexpr int rows = Rows;
+    int columns = 0;
+    int capacity = 0;
+    array<char, SEAT_LETTERS> letters{};          // letter of each column, left to right
+    uint32_t aisleAfter = 0;                      // bit c: an aisle follows column c in some row
+    array<SeatIndex, Rows * SEAT_LETTERS> index{}; // SeatCode -> seat, NO_SEAT if none
+    array<SeatIndex, Rows + 1> rowStart{};        // row - 1 -> first seat, Rows -> capacity
+    array<uint32_t, Rows> rowColumns{};           // row - 1 -> bit per column with a seat
+    array<uint32_t, Rows> rowBreaks{};            // row - 1 -> see SeatLayout::rowBreaks
+    int widestBlock = 0;                          // most seats side by side in any row
+    array<char, Rows> rowCabin{};
+    array<bool, Rows> exitRow{};
+};
+
+template <FleetModel M> struct FleetDefinition;
+
+// Flight numbers, destinations and aircraft models are interned: records
+// hold a Symbol, and comparing two of them compares integers. Symbols are
+// never removed, so a Symbol and its string stay valid for the life of the
+// process. Symbol 0 is "".
+typedef uint32_t Symbol;
+
+struct SymbolTable {
+    mutex lock;
+    deque<string> names;                    // Symbol -> string; elements never move
+    unordered_map<string_view, Symbol> ids; // views into names
+
+    SymbolTable() {
+        names.emplace_back();
+        ids.emplace(names.back(), 0);
+    }
+};
+
+// One bit per SeatIndex. Bits are claimed and released with atomic
+// read-modify-writes on their word, so seat claims need no lock and two
+// claims can never both see the same seat as free.
+struct SeatInventory {
+    atomic<uint64_t> occupied[SEAT_WORDS];
+
+    SeatInventory() {
+        for (auto& word : occupied) word.store(0, memory_order_relaxed);
+    }
+    SeatInventory(const SeatInventory& other) { *this = other; }
+    SeatInventory& operator=(const SeatInventory& other) {
+        for (int w = 0; w < SEAT_WORDS; w++) {
+            occupied[w].store(other.occupied[w].load(memory_order_relaxed), memory_order_relaxed);
+        }
+        return *this;
+    }
+};
+
+// A flight's number of free seats, kept in step with its SeatInventory by
+// the same lock-free claims. Copied the same way, so Flights stay movable.
+struct SeatCount {
+    atomic<int32_t> value;
+
+    SeatCount() { value.store(0, memory_order_relaxed); }
+    SeatCount(const SeatCount& other) { *this = other; }
+    SeatCount& operator=(const SeatCount& other) {
+        value.store(other.value.load(memory_order_relaxed), memory_order_relaxed);
+        return *this;
+    }
+};
+
+// A LayoutDefinition compiled to dense tables (see SEAT LAYOUTS). Seats are
+// numbered row by row, left to right, so a SeatIndex addresses the seat
+// bitmap and owner table directly. Compiled layouts are never freed.
+struct SeatLayout {
+    Symbol model = 0;
+    bool standard = false; // compiled from a LayoutDefinition, not generated
+    FleetModel fleet = FleetModel::None; // also available as a FleetLayout
+    int rows = 0;
+    int columns = 0;
+    string letters;        // letter of each column, left to right
+    uint32_t aisleAfter = 0; // bit c: an aisle follows column c in some row
+    array<int8_t, SEAT_LETTERS> columnOf{}; // letter -> column, -1 if the layout has none
+    vector<SeatIndex> grid;   // (row - 1) * letters.size() + column -> seat, NO_SEAT if none
+    vector<char> rowCabin;    // row - 1 -> cabin
+    vector<bool> exitRow;     // row - 1 -> emergency exit row
+    vector<SeatIndex> rowStart;  // row - 1 -> first seat of the row, rows -> capacity
+    vector<uint32_t> rowColumns; // row - 1 -> bit per column with a seat
+    vector<uint32_t> rowBreaks;  // row - 1 -> bit k: an aisle or a missing seat
+                                 // separates the row's seats k and k + 1
+    int widestBlock = 0;         // most seats side by side in any row
+    vector<SeatCode> codes;   // SeatIndex -> SeatCode
+    vector<char> cabins;      // SeatIndex -> cabin
+    vector<uint8_t> attributes; // SeatIndex -> SEAT_* flags
+
+    int capacity() const { return static_cast<int>(codes.size()); }
+};
+
+// What a passenger or party asks of the seats they are given (see SEAT
+// ALLOCATION)
+struct SeatRequest {
+    int party = 1;
+    bool window = false;
+    bool aisle = false;
+    bool together = true; // side by side in one row, when possible
+    char cabin = 0;       // 0 for any
+};
+
+struct LayoutRegistry {
+    mutex lock;
+    deque<SeatLayout> layouts; // elements never move
+    map<pair<Symbol, int>, const SeatLayout*> byAircraft; // (model, seats) -> layout
+};
+
 struct BankAccount {
     string name;
     double balance;
 };
 
+// One money movement on an account. The ledger is append-only and every
+// balance change goes through it.
+struct LedgerEntry {
+    uint64_t txnId;         // position in the ledger + 1
+    string account;
+    double amount;          // negative for a debit
+    double balance;         // account balance after this entry
+    time_t when;
+    string reference;       // booking the money moved for
+    string idempotencyKey;  // "" if the caller gave none
+};
+
+// Passenger and Booking are the working form of a record: what the menus
+// and batch mode fill in, journal records carry and the reports print. The
+// stores keep the compact form below (see COMPACT RECORDS).
 struct Passenger {
     string name, passport, id, contact;
     string seatNumber, destination;
     time_t registrationDate;
-    Passenger* next = nullptr;
-    Passenger* prev = nullptr;
-};
-
-struct Flight {
-    string flightNo, destination, dayTime, distance, plane, duration;
-    int totalSeats;
-    float price;
-    Passenger* passengerHead = nullptr;
-    map<string, bool> seatMap;
 };
 
 struct Booking {
@@ -42,17 +221,366 @@ struct Booking {
     bool isPaid;
 };
 
+// Text of at most N bytes, stored inline and NUL padded. N is the limit of
+// the field's validator, so a full field has no terminator.
+template <size_t N>
+struct FixedText {
+    char bytes[N] = {};
+};
+
+struct CompactPassenger {
+    FixedText<20> name;     // validateInput()
+    FixedText<10> passport; // validatePassport()
+    FixedText<10> id;       // validateID()
+    FixedText<15> contact;  // validatePhone()
+    Symbol destination = 0;
+    int64_t registrationDate = 0;
+};
+
+struct CompactBooking {
+    uint64_t number = 0; // bookingId is "B<number>"; 0 marks an emptied slot
+    int64_t bookingTime = 0;
+    Symbol flightNo = 0;
+    FixedText<10> passengerId;
+    SeatCode seat = INVALID_SEAT;
+    bool isPaid = false;
+};
+
+struct ManifestNode {
+    CompactPassenger passenger;
+    SeatCode seat = INVALID_SEAT;
+    ManifestNode* next = nullptr;
+    ManifestNode* prev = nullptr;
+};
+
+// Manifest nodes of one flight. Nodes are handed out from slabs sized for
+// the whole flight, so its passengers sit next to each other in memory.
+// Cancelled nodes go on a free list (linked through next) for the next
+// booking, and the slabs are released together when the flight goes away.
+const size_t MANIFEST_MIN_SLAB = 16;
+
+struct ManifestPool {
+    vector<unique_ptr<ManifestNode[]>> slabs;
+    size_t slabSize = 0;
+    size_t used = 0; // nodes handed out from the last slab
+    ManifestNode* freeList = nullptr;
+
+    ManifestPool() = default;
+    ManifestPool(ManifestPool&&) = default;
+    ManifestPool& operator=(ManifestPool&&) = default;
+};
+
+// A flight as flights.txt, the journal and snapshots describe it. In memory
+// it is split between the catalog's columns and a Flight (see FLIGHT CATALOG).
+struct FlightSchedule {
+    Symbol flightNo, destination;
+    string dayTime, distance;
+    Symbol plane;
+    string duration;
+    int totalSeats;
+    float price;
+};
+
+// The cold side of a catalog row: seat bitmap, manifest and the free-text
+// fields only detail views print. Owns its manifest, so a Flight can be
+// moved but not copied.
+struct Flight {
+    Symbol flightNo; // the key; lock shard and seat holds derive from it
+    size_t row = 0;  // position of the flight's hot columns in the catalog
+    uint64_t generation = 0; // tells it from earlier flights under the same number
+    string dayTime, distance;
+    Symbol plane;
+    string duration;
+    int totalSeats;
+    const SeatLayout* layout = nullptr;
+    ManifestNode* passengerHead = nullptr; // manifest in booking order
+    ManifestNode* passengerTail = nullptr;
+    unordered_map<string, ManifestNode*> manifestIndex; // passengerId -> manifest node
+    ManifestPool manifestPool;
+    SeatInventory seats;
+    SeatCount seatsLeft;       // kept in step with seats (see SEAT MANAGEMENT)
+    vector<int32_t> seatOwner; // SeatIndex -> index into bookings, -1 if none
+};
+
+// Flight catalog laid out as structure-of-arrays: row i of every column is
+// the same flight. Scans and filters read only the contiguous hot columns;
+// details holds the cold Flight of each row.
+struct FlightCatalog {
+    vector<Symbol> flightNo;
+    vector<Symbol> destination;
+    vector<int32_t> departure; // minutes after Monday 00:00, -1 if dayTime does not parse
+    vector<float> price;
+    vector<Flight> details;
+
+    size_t size() const { return flightNo.size(); }
+};
+
+// Case-folded search index over the destinations in the catalog (see
+// DESTINATION SEARCH). Posting lists hold destinations, not flights, and
+// are kept sorted.
+struct DestinationIndex {
+    unordered_map<Symbol, string> folded;             // destination -> lowercase name
+    unordered_map<Symbol, vector<Symbol>> flights;    // destination -> its flight numbers
+    unordered_map<uint32_t, vector<Symbol>> trigrams; // lowercase trigram -> destinations
+    vector<pair<string, Symbol>> tokens;              // lowercase words, sorted for prefix lookups
+};
+
 struct Aircraft {
-    string model;
+    Symbol model;
     int totalSeats;
     vector<string> features;
 };
 
+// Checkpoints write either the CSV text files or a single binary file
+enum class SnapshotFormat { Text, Binary };
+
+const char JOURNAL_FILE[] = "journal.log";
+const char CHECKPOINT_FILE[] = "checkpoint.txt";
+const char* const TEXT_SNAPSHOT_FILES[] = {
+    "flights.txt", "passengers.txt", "bookings.txt", "aircrafts.txt", "bank.txt", "ledger.txt"
+};
+const char BINARY_SNAPSHOT_FILE[] = "snapshot.bin";
+// Joins an aircraft's features in aircrafts.txt and in A+ journal records,
+// so it is rejected in feature input
+const char FEATURE_SEPARATOR = ';';
+const uint64_t CHECKPOINT_JOURNAL_BYTES = 1 << 20;
+const int CHECKPOINT_INTERVAL_SECONDS = 300;
+
+// Flights are partitioned into this many lock shards (see LOCKING)
+const size_t FLIGHT_SHARDS = 64;
+
+// A claimed seat that is not paid for yet. Unless a booking takes the hold
+// over first, it expires HOLD_TTL_SECONDS after the claim and the seat is
+// released again.
+const int HOLD_TTL_SECONDS = 300;
+const int HOLD_WHEEL_SLOTS = 512; // one-second ticks
+const size_t HOLD_SHARDS = 64;
+
+struct SeatHold {
+    Symbol flightNo;
+    uint64_t generation; // of the Flight whose seat bit it holds
+    SeatCode seat;
+    string passengerId;
+    long long expiresAt; // holdClock() tick
+    bool taken;          // being turned into a booking, so it no longer expires
+};
+
+// Hashed timing wheel: a hold due at tick t is linked from slot
+// t % HOLD_WHEEL_SLOTS, so expiring only visits the slots of the ticks that
+// have passed. Slot entries are keys and may be stale; the hold itself in
+// holds is authoritative.
+struct HoldWheel {
+    mutex lock;
+    unordered_map<uint64_t, SeatHold> holds; // holdKey() -> hold
+    vector<uint64_t> slots[HOLD_WHEEL_SLOTS];
+    long long tick = 0; // last tick expired
+};
+
+// Holds every flight shard, taken in ascending order (see LOCKING)
+struct AllFlightsLock {
+    AllFlightsLock();
+    ~AllFlightsLock();
+    AllFlightsLock(const AllFlightsLock&) = delete;
+    AllFlightsLock& operator=(const AllFlightsLock&) = delete;
+};
+
+// Totals of one --seat-stress worker (see BENCHMARK)
+struct SeatStressResult {
+    size_t claims = 0;
+    size_t doubleBooked = 0;
+};
+
+// One row of --memory-report (see MEMORY REPORT)
+struct MemoryTally {
+    size_t recordBefore = 0; // sizeof the record type, before and after
+    size_t recordAfter = 0;
+    size_t count = 0;
+    size_t before = 0;       // bytes of all records, string buffers included
+    size_t after = 0;
+};
+
+// Read-only mapping of a whole data file; released when it goes out of scope
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+};
+
+// snapshot.bin layout (see BINARY SNAPSHOT section): header, section
+// directory, then 8-byte aligned sections of fixed-width records that are
+// read in place from the mapped file.
+const char SNAPSHOT_MAGIC[8] = {'A', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotSection : uint32_t {
+    SECTION_STRINGS = 1,
+    SECTION_FLIGHTS,
+    SECTION_PASSENGERS,
+    SECTION_BOOKINGS,
+    SECTION_AIRCRAFT,
+    SECTION_BANK,
+    SECTION_LEDGER
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t seq;
+    uint32_t directoryCrc; // over the section directory that follows
+    uint32_t reserved;
+};
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// Offset and length into the string table section
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Fields the validators bound are stored inline and NUL padded. A value
+// that does not fit (data that never went through the validators) goes to
+// the string table instead: its bit in spilled is set and the field holds
+// a StringRef.
+struct FlightRecord {
+    StringRef flightNo, destination, dayTime, distance, plane, duration;
+    int32_t totalSeats;
+    float price;
+};
+
+struct PassengerRecord {
+    char name[20];
+    char passport[10];
+    char id[10];
+    char contact[15];
+    uint8_t spilled;
+    StringRef destination;
+    int64_t registrationDate;
+};
+
+struct BookingRecord {
+    StringRef bookingId, flightNo;
+    char passengerId[10];
+    char seatNumber[8];
+    uint8_t spilled;
+    uint8_t isPaid;
+    uint8_t reserved[4];
+    int64_t bookingTime;
+};
+
+struct AircraftRecord {
+    StringRef model;
+    StringRef features; // joined with '\n'
+    int32_t totalSeats;
+    int32_t reserved;
+};
+
+struct BankRecord {
+    char name[20];
+    uint8_t spilled;
+    uint8_t reserved[3];
+    double balance;
+};
+
+struct LedgerRecord {
+    uint64_t txnId;
+    StringRef account, reference, idempotencyKey;
+    double amount;
+    double balance;
+    int64_t when;
+};
+
+static_assert(sizeof(FlightRecord) == 56 && sizeof(PassengerRecord) == 72 &&
+    sizeof(BookingRecord) == 48 && sizeof(AircraftRecord) == 24 && sizeof(BankRecord) == 32 &&
+    sizeof(LedgerRecord) == 56,
+    "snapshot records must not contain implicit padding");
+
+// Deduplicating string table built while writing snapshot.bin
+struct StringTableBuilder {
+    string bytes;
+    unordered_map<string, StringRef> refs;
+};
+
+// Append-only journal of committed mutations (see JOURNAL section)
+struct Journal {
+    int fd = -1;
+    ino_t inode = 0;
+    uint64_t nextSeq = 1;
+    uint64_t durableSeq = 0;
+    uint64_t pendingSeq = 0;
+    uint64_t fileSize = 0;
+    string pending;
+    bool flushing = false;
+    bool failed = false;
+    mutex lock;
+    condition_variable flushed;
+};
+
+// Persisted state captured for a checkpoint (see CHECKPOINT section)
+struct Snapshot {
+    vector<FlightSchedule> flights;
+    vector<CompactPassenger> passengers;
+    vector<CompactBooking> bookings;
+    vector<Aircraft> aircrafts;
+    vector<BankAccount> bankAccounts;
+    vector<LedgerEntry> ledger;
+    SnapshotFormat format = SnapshotFormat::Text;
+    uint64_t seq = 0;
+    uint64_t journalOffset = 0;
+    uint64_t nextBookingNumber = 0;
+};
+
+// Contents of checkpoint.txt: "<seq> <status> <format> <next booking number>"
+struct CheckpointMarker {
+    uint64_t seq = 0;
+    string status;
+    SnapshotFormat format = SnapshotFormat::Text;
+    uint64_t nextBookingNumber = 0; // 0 in markers written before it was kept
+};
+
+// stat() fields that change whenever a data file is written or replaced
+struct FileStamp {
+    ino_t inode = 0;
+    off_t size = -1; // -1 when the file does not exist
+    timespec modified = {};
+};
+
+struct Checkpointer {
+    mutex running;   // held for a whole checkpoint and for a full reload
+    mutex wakeLock;
+    condition_variable wake;
+    bool requested = false;
+    bool stop = false;
+    thread worker;
+};
+
 
 // ===================== GLOBAL VARIABLES =====================
-vector<Flight> flights;
-vector<Passenger> passengers;
-vector<Booking> bookings;
+FlightCatalog catalog;
+DestinationIndex destinationIndex;
+unordered_map<Symbol, size_t> flightIndex; // flightNo -> catalog row
+vector<CompactPassenger> passengers;
+vector<CompactBooking> bookings;
+unordered_map<uint64_t, size_t> bookingIndex;             // booking number -> position in bookings
+unordered_map<string, vector<size_t>> passengerBookings;  // passengerId -> positions in bookings
+unordered_map<string, vector<size_t>> passengerIndex;     // passengerId -> its records in passengers
+vector<size_t> freeBookingSlots;                          // positions in bookings emptied by cancellation
+uint64_t nextBookingNumber = 1000;                        // high-water mark, kept in checkpoint.txt
 vector<Aircraft> aircrafts;
 vector<BankAccount> bankRecords = {
     {"Abebe Bikila", 8500.00},
@@ -64,7 +592,23 @@ vector<BankAccount> bankRecords = {
     {"Hanan Daye", 6000.00},
     {"Abiy Yosi", 5000.00}
 };
+unordered_map<string, size_t> bankIndex;                  // account name -> position in bankRecords
+vector<LedgerEntry> ledger;
+unordered_map<string, size_t> ledgerKeys;                 // idempotency key -> position in ledger
+unordered_map<string, vector<size_t>> accountHistory;     // account name -> its positions in ledger
 queue<string> userQueue;
+shared_mutex catalogMutex; // the catalog and flightIndex; shared while a Flight is in use
+array<mutex, FLIGHT_SHARDS> flightShards; // seat owners and manifest of the flights in each shard
+mutex storeMutex; // bookings, passengers, their indexes and userQueue
+mutex bankMutex;  // bankRecords, the ledger and their indexes
+array<HoldWheel, HOLD_SHARDS> holdWheels; // seat holds, sharded by holdKey()
+uint64_t flightGenerations = 0; // Flights ever added to the catalog; changes with it
+SymbolTable symbols;
+LayoutRegistry seatLayouts;
+Journal journal;
+Checkpointer checkpointer;
+SnapshotFormat snapshotFormat = SnapshotFormat::Text; // written by checkpoints
+vector<FileStamp> loadedStamps; // data files as last loaded or installed; guarded by checkpointer.running
 
 
 
@@ -75,30 +619,250 @@ string timeToString(time_t t);
 bool validatePhone(const string& phone);
 bool validatePassport(const string& passport);
 bool validateID(const string& id);
+bool validateTextField(const string& text);
 bool validateInput(const string& input);
+bool validatePaymentKey(const string& key);
+
+// Symbol Table
+Symbol intern(string_view text);
+bool findSymbol(string_view text, Symbol& symbol);
+const string& symbolName(Symbol symbol);
+
+// Compact Records
+template <size_t N> bool setFixedText(FixedText<N>& field, string_view text);
+template <size_t N> string_view fixedText(const FixedText<N>& field);
+string formatBookingId(uint64_t number);
+bool parseBookingId(string_view bookingId, uint64_t& number);
+bool packPassenger(const Passenger& passenger, CompactPassenger& record);
+Passenger unpackPassenger(const CompactPassenger& record);
+bool packBooking(const Booking& booking, CompactBooking& record);
+Booking unpackBooking(const CompactBooking& record);
+
+// Locking
+mutex& flightLock(Symbol flightNo);
+
+// Flight Catalog
+Flight* findFlight(Symbol flightNo);
+Flight* findFlight(const string& flightNo);
+int32_t parseDeparture(const string& dayTime);
+bool addFlightToCatalog(const FlightSchedule& schedule);
+bool removeFlightFromCatalog(Symbol flightNo);
+void clearCatalog(size_t expected = 0);
+FlightSchedule flightSchedule(size_t row);
+const Aircraft* findAircraft(Symbol model);
+const Aircraft* findAircraft(const string& model);
+
+// Destination Search
+string foldCase(string_view text);
+void indexDestination(Symbol destination, Symbol flightNo);
+void unindexDestination(Symbol destination, Symbol flightNo);
+vector<size_t> searchDestinations(const string& text);
+vector<Symbol> suggestDestinations(const string& prefix);
+
+// Booking Store
+void addBooking(const CompactBooking& booking);
+void removeBookingAt(size_t index);
+int findBookingIndex(const string& bookingId);
+const vector<size_t>& bookingsOfPassenger(const string& passengerId);
+bool hasBookingOnFlight(const string& passengerId, Symbol flightNo);
+bool isPassengerOnFlight(const string& passengerId, Symbol flightNo);
+void setBookingPassenger(size_t index, const FixedText<10>& passengerId);
+uint64_t takeBookingNumber();
+size_t liveBookingCount();
+void clearBookings();
+void addPassengerRecord(const CompactPassenger& passenger);
+CompactPassenger* findPassenger(const string& passengerId, Symbol destination);
+void setPassengerId(CompactPassenger& passenger, const FixedText<10>& passengerId);
+void clearPassengerRecords();
+
+// Bank Ledger
+void rebuildBankIndex();
+BankAccount* findAccount(const string& name);
 bool isPassengerInBankSystem(const string& name);
 double getPassengerBalance(const string& name);
-bool processPayment(const string& name, double amount);
+void addLedgerEntry(const LedgerEntry& entry);
+bool applyLedgerEntry(LedgerEntry entry);
+void clearLedger();
+string paymentReference(const string& idempotencyKey);
+void streamAccountHistory(const string& name, ostream& out);
 
 // File Handling
+bool mapFile(const char* path, MappedFile& file);
+size_t countRecords(const MappedFile& file);
+bool nextRecord(const char*& cursor, const char* end, vector<string_view>& fields);
+template <typename T> bool parseNumber(string_view text, T& value);
+const char* formatName(SnapshotFormat format);
+bool parseFormat(const string& name, SnapshotFormat& format);
+vector<string> snapshotFiles(SnapshotFormat format);
+void writeTextSnapshot(const Snapshot& snapshot, const string& suffix);
+void loadTextSnapshot();
 void saveData();
-void loadData();
+bool loadData();
+
+// Binary Snapshot
+StringRef addSnapshotString(StringTableBuilder& strings, const string& value);
+string snapshotString(string_view table, StringRef ref);
+void packField(char* field, size_t width, string_view value, uint8_t& spilled, int bit,
+               StringTableBuilder& strings);
+string unpackField(const char* field, size_t width, bool spilled, string_view table);
+void writeBinarySnapshot(const Snapshot& snapshot, const string& path);
+void loadBinarySnapshot(const char* path);
+
+// Journal
+uint32_t crc32(const char* data, size_t length);
+void openJournal();
+uint64_t journalAppend(const vector<string>& fields);
+bool flushJournal(unique_lock<mutex>& guard);
+void journalSync(uint64_t seq);
+void syncDeferredJournal();
+void replayJournal(uint64_t coveredSeq);
+bool decodeJournalRecord(const string& line, vector<string>& fields);
+bool decodeJournalBooking(const vector<string>& fields, CompactBooking& record,
+                          CompactPassenger& passengerRecord);
+void applyJournalRecord(const vector<string>& fields);
+
+// Checkpoint
+void syncFile(const string& path);
+void syncDirectory();
+Snapshot captureSnapshot();
+void writeCheckpointMarker(uint64_t seq, const string& status, SnapshotFormat format,
+                           uint64_t bookingNumber);
+CheckpointMarker readCheckpointMarker();
+void installSnapshot(const Snapshot& snapshot);
+void compactJournal(uint64_t offset);
+void recoverCheckpoint();
+void requestCheckpoint();
+void checkpointLoop();
+void startCheckpointer();
+void stopCheckpointer();
+
+// State Cache
+FileStamp stampFile(const string& path);
+bool sameStamp(const FileStamp& a, const FileStamp& b);
+vector<FileStamp> stampDataFiles();
+bool dataChangedOnDisk();
+bool reloadData();
+void refreshState();
+
+// State Changes
+bool applyAddFlight(const FlightSchedule& flight);
+bool applyDeleteFlight(const string& flightNo);
+void applyBooking(const CompactBooking& booking, const CompactPassenger& passenger);
+void applyCancelBooking(size_t position);
+void applyPostponeBooking(size_t position, const CompactPassenger& details, SeatCode seat, time_t when);
+bool applyAddAircraft(const Aircraft& aircraft);
+bool applyDeleteAircraft(const string& model);
+void applySetBalance(const string& name, double balance);
+void commitAddFlight(const FlightSchedule& flight);
+void commitDeleteFlight(const string& flightNo);
+string commitBooking(const Flight& flight, Booking& booking, const Passenger& passenger,
+                     const string& paymentKey);
+string commitGroupBooking(const Flight& flight, vector<Booking>& group, const vector<Passenger>& party,
+                          const string& payer, const string& paymentKey);
+Symbol flightOfBooking(const string& bookingId);
+bool commitCancelBooking(const string& bookingId);
+string commitPostponeBooking(const string& bookingId, const Passenger& details);
+void commitAddAircraft(const Aircraft& aircraft);
+void commitDeleteAircraft(const string& model);
+
+// Seat Layouts
+constexpr SeatCode makeSeatCode(char letter, int row);
+template <FleetModel M> LayoutDefinition fleetDefinition();
+const char* cabinName(char cabin);
+constexpr bool seatsApart(uint32_t sectionSeats, uint32_t aisleAfter, int left, int right);
+constexpr int widestRun(uint32_t breaks, int count);
+template <FleetModel M> constexpr int fleetRows();
+template <FleetModel M> constexpr FleetLayout<fleetRows<M>()> buildFleetLayout();
+SeatIndex layoutSeatIndex(const SeatLayout& layout, SeatCode code);
+template <int Rows> SeatIndex layoutSeatIndex(const FleetLayout<Rows>& layout, SeatCode code);
+SeatIndex parseLayoutSeat(const SeatLayout& layout, string_view seat, SeatCode& code);
+template <int Rows> SeatIndex parseLayoutSeat(const FleetLayout<Rows>& layout, string_view seat, SeatCode& code);
+SeatIndex seatIndexOf(const SeatLayout& layout, SeatCode code);
+SeatIndex parseSeat(const SeatLayout& layout, string_view seat, SeatCode& code);
+SeatLayout compileLayout(const LayoutDefinition& definition);
+SeatLayout uniformLayout(int totalSeats);
+const SeatLayout* layoutFor(Symbol model, int totalSeats);
+int standardSeatCount(const string& model);
+string describeLayout(const SeatLayout& layout);
 
 // Seat Management
+SeatCode parseSeatCode(string_view seat);
+string seatCodeToString(SeatCode code);
+bool isSeatOccupied(const SeatInventory& seats, SeatIndex seat);
+bool tryClaimSeat(SeatInventory& seats, SeatIndex seat);
+bool releaseSeat(SeatInventory& seats, SeatIndex seat);
+int occupiedSeatCount(const SeatInventory& seats);
+bool occupyFlightSeat(Flight& flight, SeatCode code);
+void releaseFlightSeat(Flight& flight, SeatCode code);
+int availableSeats(size_t row);
+int availableSeats(const Flight& flight);
+int seatOwnerOf(const Flight& flight, SeatCode code);
+void assignSeatOwner(Flight& flight, SeatCode code, int position);
+void clearSeatOwner(Flight& flight, SeatCode code);
 void initializeSeats(Flight& flight);
+template <typename Layout> uint32_t rowOccupancy(const Layout& layout, const SeatInventory& seats, int row);
+template <typename Layout> uint32_t occupiedColumns(const Layout& layout, const SeatInventory& seats, int row);
+template <typename Layout> void renderSeatMap(const Layout& layout, const SeatInventory& seats, ostream& out);
 void displaySeatMap(const Flight& flight);
 bool bookSeat(Flight& flight, Passenger* passenger, const string& seatNumber);
 
+// Seat Allocation
+uint32_t blockStarts(uint32_t free, uint32_t joined, int length);
+uint32_t blockTouches(uint32_t seats, int length);
+template <typename Layout> vector<SeatIndex> findSeats(const Layout& layout, const SeatInventory& seats,
+                                                       const SeatRequest& request);
+vector<SeatIndex> allocateSeats(const SeatLayout& layout, const SeatInventory& seats, const SeatRequest& request);
+bool parseSeatRequest(const string& text, SeatRequest& request);
+
+// Seat Holds
+long long holdClock();
+uint64_t holdKey(Symbol flightNo, SeatCode seat);
+HoldWheel& holdWheelFor(uint64_t key);
+void placeHold(const Flight& flight, SeatCode seat, const string& passengerId);
+bool takeOverExpiredHold(const Flight& flight, SeatCode seat, const string& passengerId);
+bool takeHold(Symbol flightNo, SeatCode seat, const string& passengerId);
+bool releaseHold(Symbol flightNo, SeatCode seat, const string& passengerId);
+void dropHold(Symbol flightNo, SeatCode seat, const string& passengerId);
+void dropFlightHolds(Symbol flightNo);
+void clearHolds();
+void expireHolds();
+
 // Passenger List Management
-void addPassengerToFlight(Flight& flight, Passenger* passenger);
+void addPassengerToFlight(Flight& flight, ManifestNode* node);
+ManifestNode* findManifestPassenger(Flight& flight, const string& passengerId);
+void renameManifestPassenger(Flight& flight, ManifestNode* node, const FixedText<10>& passengerId);
 void removePassengerFromFlight(Flight& flight, const string& passengerId);
+void linkManifestPassenger(const CompactBooking& booking);
+ManifestNode* allocateManifestNode(Flight& flight, const CompactPassenger& passenger, SeatCode seat);
+void freeManifestNode(Flight& flight, ManifestNode* node);
+void releaseManifest(Flight& flight);
+
+// Booking Operations
+string claimSeat(Flight& flight, Passenger& passenger, const string& seatNumber);
+string claimBestSeat(Flight& flight, Passenger& passenger, SeatRequest request);
+void abandonSeat(Flight& flight, const Passenger& passenger);
+string validatePassengerDetails(const Passenger& passenger);
+string completeBooking(const Flight& flight, const Passenger& passenger, Booking& booking,
+                       const string& paymentKey);
+string bookHeldSeat(Flight& flight, const Passenger& passenger, Booking& booking,
+                    const string& paymentKey);
+string validateGroup(const Flight& flight, const vector<Passenger>& party);
+string claimGroupSeats(Flight& flight, vector<Passenger>& party, const string& choice);
+void abandonGroupSeats(Flight& flight, const vector<Passenger>& party);
+string bookHeldGroup(Flight& flight, const vector<Passenger>& party, const string& payer,
+                     vector<Booking>& group, const string& paymentKey);
+string postponeToHeldSeat(Flight& flight, const string& bookingId, const Passenger& details);
+string findOwnedBooking(const string& bookingId, const string& passengerId, Symbol& flightNo);
+string cancelBookingById(const string& bookingId);
 
 // Flight Functions
 void viewAllFlights();
 void searchByDestination();
 
 // Booking Functions
+Flight* lockFlight(shared_lock<shared_mutex>& catalogGuard, const string& flightNo);
 void bookFlight();
+void bookGroupFlight();
 void cancelBooking();
 void viewCurrentBooking();
 void postponeBooking();
@@ -121,6 +885,28 @@ void displayBankStatement();
 void adminMenu();
 void passengerMenu();
 
+// Batch Mode
+vector<string> splitCommand(const string& line);
+string runBatchCommand(const vector<string>& args);
+int runBatch(const string& path);
+
+// Benchmark
+void resetBenchmarkState(size_t flightCount);
+void bookAllSeats(size_t firstFlight, size_t flightCount, size_t worker);
+int runBenchmark(int maxThreads);
+void stressSeats(Flight& flight, atomic<int>* owners, int worker, SeatStressResult& result);
+int runSeatStress(int maxThreads);
+template <typename Layout> size_t claimEverySeat(const Layout& layout, const vector<string>& names, SeatInventory& seats);
+template <typename Layout> double timeSeatClaims(const Layout& layout, const vector<string>& names, size_t& claimed);
+template <typename Layout> double timeSeatMaps(const Layout& layout, const SeatInventory& seats, string& map);
+int runLayoutBenchmark();
+int runAllocationBenchmark();
+
+// Memory Report
+size_t heapBytes(const string& text);
+void printMemoryRow(const char* label, const MemoryTally& tally);
+int runMemoryReport();
+
 // ===================== UTILITY FUNCTIONS =====================
 time_t getCurrentTime() { return time(nullptr); }
 
@@ -142,351 +928,3403 @@ bool validateID(const string& id) {
     return id.length() <= 10 && all_of(id.begin(), id.end(), ::isdigit);
 }
 
+// Free text is stored as is in the CSV text files, where a comma ends a
+// field and a newline a record. Input is checked this way whichever format
+// is in use, so the data can always be converted to text.
+bool validateTextField(const string& text) {
+    return none_of(text.begin(), text.end(), [](char c) {
+        return c == ',' || iscntrl(static_cast<unsigned char>(c));
+    });
+}
+
 bool validateInput(const string& input) {
-    return !input.empty() && input.length() <= 20;
+    return !input.empty() && input.length() <= 20 && validateTextField(input);
 }
 
-bool isPassengerInBankSystem(const string& name) {
-    return any_of(bankRecords.begin(), bankRecords.end(),
-        [&name](const BankAccount& acc) { return acc.name == name; });
+// Keys are stored in ledger.txt next to the payment
+bool validatePaymentKey(const string& key) {
+    return key.length() <= 64 && validateTextField(key) && key.find(' ') == string::npos;
 }
 
-double getPassengerBalance(const string& name) {
-    auto it = find_if(bankRecords.begin(), bankRecords.end(),
-        [&name](const BankAccount& acc) { return acc.name == name; });
-    return (it != bankRecords.end()) ? it->balance : 0.0;
+// ===================== SYMBOL TABLE =====================
+// symbols.lock is a leaf lock, like a hold wheel's: nothing else is taken
+// while it is held. The strings live in a deque, so the reference
+// symbolName returns stays valid once the lock is released.
+Symbol intern(string_view text) {
+    lock_guard<mutex> guard(symbols.lock);
+    auto it = symbols.ids.find(text);
+    if (it != symbols.ids.end()) return it->second;
+
+    Symbol symbol = static_cast<Symbol>(symbols.names.size());
+    symbols.names.emplace_back(text);
+    symbols.ids.emplace(symbols.names.back(), symbol);
+    return symbol;
 }
 
-bool processPayment(const string& name, double amount) {
-    auto it = find_if(bankRecords.begin(), bankRecords.end(),
-        [&name](const BankAccount& acc) { return acc.name == name; });
-    
-    if (it != bankRecords.end() && it->balance >= amount) {
-        it->balance -= amount;
-        return true;
+// Looks a name up without interning it, so typed-in names that match
+// nothing do not grow the table
+bool findSymbol(string_view text, Symbol& symbol) {
+    lock_guard<mutex> guard(symbols.lock);
+    auto it = symbols.ids.find(text);
+    if (it == symbols.ids.end()) return false;
+    symbol = it->second;
+    return true;
+}
+
+const string& symbolName(Symbol symbol) {
+    lock_guard<mutex> guard(symbols.lock);
+    return symbols.names[symbol];
+}
+
+// ===================== COMPACT RECORDS =====================
+// The stores keep passengers and bookings as CompactPassenger and
+// CompactBooking: the fields the validators bound are FixedText, the
+// booking ID is its number, the seat its SeatCode and destination and
+// flightNo are Symbols. pack* fails if a value does not fit, which only
+// data that never went through the validators can cause.
+template <size_t N>
+bool setFixedText(FixedText<N>& field, string_view text) {
+    if (text.size() > N || text.find('\0') != string_view::npos) return false;
+    memset(field.bytes, 0, N);
+    memcpy(field.bytes, text.data(), text.size());
+    return true;
+}
+
+template <size_t N>
+string_view fixedText(const FixedText<N>& field) {
+    const char* end = static_cast<const char*>(memchr(field.bytes, '\0', N));
+    return string_view(field.bytes, end ? end - field.bytes : N);
+}
+
+string formatBookingId(uint64_t number) {
+    return "B" + to_string(number);
+}
+
+bool parseBookingId(string_view bookingId, uint64_t& number) {
+    return bookingId.size() > 1 && bookingId[0] == 'B' &&
+           parseNumber(bookingId.substr(1), number) && number > 0;
+}
+
+bool packPassenger(const Passenger& passenger, CompactPassenger& record) {
+    if (!setFixedText(record.name, passenger.name) || !setFixedText(record.passport, passenger.passport) ||
+        !setFixedText(record.id, passenger.id) || !setFixedText(record.contact, passenger.contact)) {
+        return false;
     }
-    return false;
+    record.destination = intern(passenger.destination);
+    record.registrationDate = passenger.registrationDate;
+    return true;
 }
 
-// ===================== FILE HANDLING =====================
-void saveData() {
-   try {
+Passenger unpackPassenger(const CompactPassenger& record) {
+    Passenger passenger;
+    passenger.name = fixedText(record.name);
+    passenger.passport = fixedText(record.passport);
+    passenger.id = fixedText(record.id);
+    passenger.contact = fixedText(record.contact);
+    passenger.destination = symbolName(record.destination);
+    passenger.registrationDate = record.registrationDate;
+    return passenger;
+}
 
-        ofstream ffile("flights.txt");
+bool packBooking(const Booking& booking, CompactBooking& record) {
+    record.seat = parseSeatCode(booking.seatNumber);
+    if (!parseBookingId(booking.bookingId, record.number) || record.seat == INVALID_SEAT ||
+        !setFixedText(record.passengerId, booking.passengerId)) {
+        return false;
+    }
+    record.flightNo = intern(booking.flightNo);
+    record.bookingTime = booking.bookingTime;
+    record.isPaid = booking.isPaid;
+    return true;
+}
 
-        if (!ffile.is_open()) throw runtime_error("Cannot open flights.txt for writing");
+Booking unpackBooking(const CompactBooking& record) {
+    Booking booking;
+    booking.bookingId = formatBookingId(record.number);
+    booking.flightNo = symbolName(record.flightNo);
+    booking.passengerId = fixedText(record.passengerId);
+    booking.seatNumber = seatCodeToString(record.seat);
+    booking.bookingTime = record.bookingTime;
+    booking.isPaid = record.isPaid;
+    return booking;
+}
 
-        for (const auto& f : flights) {
+// ===================== LOCKING =====================
+// catalogMutex keeps Flights in place: a booking, a claim or anything else
+// that looks a flight up and keeps using it holds it shared for the whole
+// operation, and only adding, deleting and reloading flights, which move
+// rows of the catalog, take it exclusively. The interactive menus never hold
+// it while waiting for input; they look the flight up again by number for
+// each step (see lockFlight). A flight shard lock guards the
+// seat owners and manifest of every flight hashed to that shard, so
+// bookings on flights in different shards never wait for each other. Seat
+// bits are atomic (see SeatInventory) and are claimed without any shard
+// lock. storeMutex (booking store, passenger records, userQueue) and
+// bankMutex are only held for the few index updates of a commit. Anything
+// that spans flights - catalog changes, aircraft changes, checkpoint
+// capture and reloads - takes every shard in ascending order, so two of
+// them can never deadlock. Lock order: catalogMutex, shards (ascending),
+// storeMutex, bankMutex, journal.lock; a hold wheel's lock is taken last
+// and never held while taking another. Catalog changes hold every shard,
+// so a shard lock alone also keeps flightIndex in place. The symbol
+// table's lock is a leaf as well.
+mutex& flightLock(Symbol flightNo) {
+    return flightShards[flightNo % FLIGHT_SHARDS];
+}
 
-            ffile << f.flightNo << "," << f.destination << "," << f.dayTime << ","
+AllFlightsLock::AllFlightsLock() {
+    for (auto& shard : flightShards) shard.lock();
+}
 
-                  << f.distance << "," << f.plane << "," << f.duration << ","
+AllFlightsLock::~AllFlightsLock() {
+    for (size_t i = FLIGHT_SHARDS; i-- > 0;) flightShards[i].unlock();
+}
 
-                  << f.totalSeats << "," << f.price << "\n";
+// ===================== FLIGHT CATALOG =====================
+// flightIndex stores catalog rows rather than pointers, so it survives
+// reallocation of the columns; erasing re-indexes the row moved into the
+// gap.
+Flight* findFlight(Symbol flightNo) {
+    auto it = flightIndex.find(flightNo);
+    return (it != flightIndex.end()) ? &catalog.details[it->second] : nullptr;
+}
 
-        }
+Flight* findFlight(const string& flightNo) {
+    Symbol symbol;
+    return findSymbol(flightNo, symbol) ? findFlight(symbol) : nullptr;
+}
 
-        ffile.close();
+// "Mon 08:00 AM" or "Wed 21:30" -> minutes after Monday 00:00, or -1
+int32_t parseDeparture(const string& dayTime) {
+    static const char* const DAYS[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+    char day[4] = {}, half[3] = {};
+    int hour, minute;
+    int parsed = sscanf(dayTime.c_str(), "%3s %d:%d %2s", day, &hour, &minute, half);
+    if (parsed < 3 || minute < 0 || minute > 59) return -1;
+
+    auto d = find_if(begin(DAYS), end(DAYS), [&day](const char* name) { return strcasecmp(name, day) == 0; });
+    if (d == end(DAYS)) return -1;
+
+    if (parsed == 4) {
+        bool pm = strcasecmp(half, "PM") == 0;
+        if ((!pm && strcasecmp(half, "AM") != 0) || hour < 1 || hour > 12) return -1;
+        hour = hour % 12 + (pm ? 12 : 0);
+    } else if (hour < 0 || hour > 23) {
+        return -1;
+    }
+    return static_cast<int32_t>((d - begin(DAYS)) * 24 * 60 + hour * 60 + minute);
+}
 
-         ofstream pfile("passengers.txt");
+// Splits the schedule into a new row of hot columns and its cold Flight. The
+// seat count is the one of the layout the aircraft gets (see SEAT LAYOUTS).
+bool addFlightToCatalog(const FlightSchedule& schedule) {
+    if (flightIndex.count(schedule.flightNo)) return false;
+    indexDestination(schedule.destination, schedule.flightNo);
 
-        if (!pfile.is_open()) throw runtime_error("Cannot open passengers.txt for writing");
+    size_t row = catalog.size();
+    flightIndex[schedule.flightNo] = row;
+    catalog.flightNo.push_back(schedule.flightNo);
+    catalog.destination.push_back(schedule.destination);
+    catalog.departure.push_back(parseDeparture(schedule.dayTime));
+    catalog.price.push_back(schedule.price);
 
-        for (const auto& p : passengers) {
+    Flight f;
+    f.flightNo = schedule.flightNo;
+    f.row = row;
+    f.generation = ++flightGenerations;
+    f.dayTime = schedule.dayTime;
+    f.distance = schedule.distance;
+    f.plane = schedule.plane;
+    f.duration = schedule.duration;
+    f.layout = layoutFor(schedule.plane, schedule.totalSeats);
+    f.totalSeats = f.layout->capacity();
+    f.seatsLeft.value.store(f.totalSeats, memory_order_relaxed);
+    catalog.details.push_back(move(f));
+    return true;
+}
 
-            pfile << p.name << "," << p.passport << "," << p.id << "," 
+// The last row moves into the gap, so deleting a flight changes the row of
+// at most one other flight
+bool removeFlightFromCatalog(Symbol flightNo) {
+    auto it = flightIndex.find(flightNo);
+    if (it == flightIndex.end()) return false;
+
+    size_t pos = it->second;
+    size_t last = catalog.size() - 1;
+    flightIndex.erase(it);
+    unindexDestination(catalog.destination[pos], flightNo);
+    if (pos != last) {
+        catalog.flightNo[pos] = catalog.flightNo[last];
+        catalog.destination[pos] = catalog.destination[last];
+        catalog.departure[pos] = catalog.departure[last];
+        catalog.price[pos] = catalog.price[last];
+        catalog.details[pos] = move(catalog.details[last]);
+        catalog.details[pos].row = pos;
+        flightIndex[catalog.flightNo[pos]] = pos;
+    }
+    catalog.flightNo.pop_back();
+    catalog.destination.pop_back();
+    catalog.departure.pop_back();
+    catalog.price.pop_back();
+    catalog.details.pop_back();
+    return true;
+}
 
-                  << p.contact << "," << p.destination << "," << p.registrationDate << "\n";
+void clearCatalog(size_t expected) {
+    catalog = FlightCatalog();
+    flightIndex.clear();
+    destinationIndex = DestinationIndex();
+
+    catalog.flightNo.reserve(expected);
+    catalog.destination.reserve(expected);
+    catalog.departure.reserve(expected);
+    catalog.price.reserve(expected);
+    catalog.details.reserve(expected);
+    flightIndex.reserve(expected);
+}
 
-        }
+// Reassembles a row for the files, the journal and checkpoints
+FlightSchedule flightSchedule(size_t row) {
+    const Flight& f = catalog.details[row];
+    return {catalog.flightNo[row], catalog.destination[row], f.dayTime, f.distance,
+            f.plane, f.duration, f.totalSeats, catalog.price[row]};
+}
+
+const Aircraft* findAircraft(Symbol model) {
+    auto it = find_if(aircrafts.begin(), aircrafts.end(),
+        [model](const Aircraft& a) { return a.model == model; });
+    return it != aircrafts.end() ? &*it : nullptr;
+}
 
-        pfile.close();
+const Aircraft* findAircraft(const string& model) {
+    Symbol symbol;
+    return findSymbol(model, symbol) ? findAircraft(symbol) : nullptr;
+}
 
+// ===================== DESTINATION SEARCH =====================
+// Destinations are indexed once each, lowercased, under every trigram of
+// their name, so a query of three or more characters only checks the
+// destinations on its rarest trigram's posting list. Shorter queries check
+// each distinct destination, still far fewer than there are flights. Words
+// are kept sorted as well for prefix (type-ahead) lookups. The catalog
+// updates the index as flights are added and removed.
+string foldCase(string_view text) {
+    string folded(text);
+    transform(folded.begin(), folded.end(), folded.begin(),
+              [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return folded;
+}
 
+uint32_t trigramKey(const string& text, size_t pos) {
+    return uint32_t(uint8_t(text[pos])) << 16 | uint32_t(uint8_t(text[pos + 1])) << 8 | uint8_t(text[pos + 2]);
+}
 
-        ofstream bfile("bookings.txt");
+vector<string> destinationWords(const string& folded) {
+    vector<string> words;
+    string word;
+    for (char c : folded) {
+        if (isalnum(static_cast<unsigned char>(c))) {
+            word += c;
+        } else if (!word.empty()) {
+            words.push_back(move(word));
+            word.clear();
+        }
+    }
+    if (!word.empty()) words.push_back(move(word));
+    return words;
+}
 
-        if (!bfile.is_open()) throw runtime_error("Cannot open bookings.txt for writing");
+void indexDestination(Symbol destination, Symbol flightNo) {
+    vector<Symbol>& flightsTo = destinationIndex.flights[destination];
+    flightsTo.push_back(flightNo);
+    if (flightsTo.size() > 1) return;
 
-        for (const auto& b : bookings) {
+    string folded = foldCase(symbolName(destination));
+    for (size_t i = 0; i + 3 <= folded.size(); i++) {
+        vector<Symbol>& posting = destinationIndex.trigrams[trigramKey(folded, i)];
+        auto it = lower_bound(posting.begin(), posting.end(), destination);
+        if (it == posting.end() || *it != destination) posting.insert(it, destination);
+    }
+    for (auto& word : destinationWords(folded)) {
+        pair<string, Symbol> token(move(word), destination);
+        auto& tokens = destinationIndex.tokens;
+        auto it = lower_bound(tokens.begin(), tokens.end(), token);
+        if (it == tokens.end() || *it != token) tokens.insert(it, move(token));
+    }
+    destinationIndex.folded[destination] = move(folded);
+}
 
-            bfile << b.bookingId << "," << b.flightNo << "," << b.passengerId << ","
+// Drops the destination from the index with its last flight
+void unindexDestination(Symbol destination, Symbol flightNo) {
+    auto it = destinationIndex.flights.find(destination);
+    if (it == destinationIndex.flights.end()) return;
+
+    vector<Symbol>& flightsTo = it->second;
+    flightsTo.erase(remove(flightsTo.begin(), flightsTo.end(), flightNo), flightsTo.end());
+    if (!flightsTo.empty()) return;
+    destinationIndex.flights.erase(it);
+
+    auto name = destinationIndex.folded.find(destination);
+    const string& folded = name->second;
+    for (size_t i = 0; i + 3 <= folded.size(); i++) {
+        auto posting = destinationIndex.trigrams.find(trigramKey(folded, i));
+        if (posting == destinationIndex.trigrams.end()) continue;
+        vector<Symbol>& list = posting->second;
+        auto entry = lower_bound(list.begin(), list.end(), destination);
+        if (entry != list.end() && *entry == destination) list.erase(entry);
+        if (list.empty()) destinationIndex.trigrams.erase(posting);
+    }
+    for (auto& word : destinationWords(folded)) {
+        auto& tokens = destinationIndex.tokens;
+        auto token = lower_bound(tokens.begin(), tokens.end(), make_pair(word, destination));
+        if (token != tokens.end() && token->second == destination && token->first == word) tokens.erase(token);
+    }
+    destinationIndex.folded.erase(name);
+}
 
-                  << b.seatNumber << "," << b.bookingTime << "," << b.isPaid << "\n";
+// Catalog rows of the flights whose destination contains text, ignoring
+// case, in catalog order
+vector<size_t> searchDestinations(const string& text) {
+    string query = foldCase(text);
+    vector<Symbol> matched;
 
+    if (query.size() < 3) {
+        for (const auto& entry : destinationIndex.folded) {
+            if (entry.second.find(query) != string::npos) matched.push_back(entry.first);
         }
+    } else {
+        const vector<Symbol>* rarest = nullptr;
+        for (size_t i = 0; i + 3 <= query.size(); i++) {
+            auto posting = destinationIndex.trigrams.find(trigramKey(query, i));
+            if (posting == destinationIndex.trigrams.end()) return {};
+            if (!rarest || posting->second.size() < rarest->size()) rarest = &posting->second;
+        }
+        // Having every trigram does not make the query a substring
+        for (Symbol destination : *rarest) {
+            if (destinationIndex.folded.at(destination).find(query) != string::npos) {
+                matched.push_back(destination);
+            }
+        }
+    }
 
-        bfile.close();
+    vector<size_t> rows;
+    for (Symbol destination : matched) {
+        for (Symbol flightNo : destinationIndex.flights.at(destination)) rows.push_back(flightIndex.at(flightNo));
+    }
+    sort(rows.begin(), rows.end());
+    return rows;
+}
 
-    } catch (const exception& e) {
+// Destinations with a word starting with prefix, ignoring case, by name
+vector<Symbol> suggestDestinations(const string& prefix) {
+    string folded = foldCase(prefix);
+    const auto& tokens = destinationIndex.tokens;
+    vector<Symbol> found;
+    for (auto it = lower_bound(tokens.begin(), tokens.end(), make_pair(folded, Symbol(0)));
+         it != tokens.end() && it->first.compare(0, folded.size(), folded) == 0; ++it) {
+        found.push_back(it->second);
+    }
 
-        cout << "Error saving data: " << e.what() << "\n";
+    // A destination comes back once per matching word; ties on the folded
+    // name are broken by symbol so its copies end up next to each other
+    sort(found.begin(), found.end(), [](Symbol a, Symbol b) {
+        const string& nameA = destinationIndex.folded.at(a);
+        const string& nameB = destinationIndex.folded.at(b);
+        return nameA != nameB ? nameA < nameB : a < b;
+    });
+    found.erase(unique(found.begin(), found.end()), found.end());
+    return found;
+}
+
+// ===================== BOOKING STORE =====================
+// Bookings are stored compact (see COMPACT RECORDS), indexed by booking
+// number and by passengerId, and every booking is registered as the owner
+// of its seat on its flight. A booking keeps its position until it is
+// cancelled; the emptied slot (number 0) is reused by a later booking.
+// Positions never move, so cancelling never has to touch the seat owners
+// of another flight.
+void unlinkPassengerBooking(const string& passengerId, size_t index) {
+    auto it = passengerBookings.find(passengerId);
+    if (it == passengerBookings.end()) return;
+
+    vector<size_t>& positions = it->second;
+    positions.erase(remove(positions.begin(), positions.end(), index), positions.end());
+    if (positions.empty()) passengerBookings.erase(it);
+}
+
+void addBooking(const CompactBooking& booking) {
+    size_t index;
+    if (!freeBookingSlots.empty()) {
+        index = freeBookingSlots.back();
+        freeBookingSlots.pop_back();
+        bookings[index] = booking;
+    } else {
+        index = bookings.size();
+        bookings.push_back(booking);
+    }
+    bookingIndex[booking.number] = index;
+    passengerBookings[string(fixedText(booking.passengerId))].push_back(index);
+
+    // Later IDs continue after the highest one seen
+    nextBookingNumber = max(nextBookingNumber, booking.number + 1);
+
+    Flight* flight = findFlight(booking.flightNo);
+    if (flight) {
+        occupyFlightSeat(*flight, booking.seat);
+        assignSeatOwner(*flight, booking.seat, static_cast<int>(index));
+    }
+}
+
+void removeBookingAt(size_t index) {
+    const CompactBooking& removed = bookings[index];
+    Flight* flight = findFlight(removed.flightNo);
+    if (flight && seatOwnerOf(*flight, removed.seat) == static_cast<int>(index)) {
+        clearSeatOwner(*flight, removed.seat);
     }
+    bookingIndex.erase(removed.number);
+    unlinkPassengerBooking(string(fixedText(removed.passengerId)), index);
 
+    bookings[index] = CompactBooking{};
+    freeBookingSlots.push_back(index);
 }
 
-void loadData() {
-    try {
+int findBookingIndex(const string& bookingId) {
+    uint64_t number;
+    if (!parseBookingId(bookingId, number)) return -1;
+    auto it = bookingIndex.find(number);
+    return (it != bookingIndex.end()) ? static_cast<int>(it->second) : -1;
+}
 
-        ifstream ffile("flights.txt");
+const vector<size_t>& bookingsOfPassenger(const string& passengerId) {
+    static const vector<size_t> none;
+    auto it = passengerBookings.find(passengerId);
+    return (it != passengerBookings.end()) ? it->second : none;
+}
 
-        if (ffile.is_open()) {
+bool hasBookingOnFlight(const string& passengerId, Symbol flightNo) {
+    for (size_t index : bookingsOfPassenger(passengerId)) {
+        if (bookings[index].flightNo == flightNo) return true;
+    }
+    return false;
+}
 
-            flights.clear();
+// hasBookingOnFlight for checks made before a commit, which repeats them
+// under its locks. Takes storeMutex.
+bool isPassengerOnFlight(const string& passengerId, Symbol flightNo) {
+    lock_guard<mutex> guard(storeMutex);
+    return hasBookingOnFlight(passengerId, flightNo);
+}
 
-            string line;
+void setBookingPassenger(size_t index, const FixedText<10>& passengerId) {
+    CompactBooking& booking = bookings[index];
+    if (fixedText(booking.passengerId) == fixedText(passengerId)) return;
 
-            while (getline(ffile, line)) {
+    unlinkPassengerBooking(string(fixedText(booking.passengerId)), index);
+    booking.passengerId = passengerId;
+    passengerBookings[string(fixedText(passengerId))].push_back(index);
+}
 
-                stringstream ss(line);
+// Hands every number out once, so concurrent bookings never share an ID
+// and a cancelled ID is not given to someone else, even after a restart:
+// nextBookingNumber only grows, and each checkpoint records it next to the
+// snapshot (see CheckpointMarker). Caller holds storeMutex
+uint64_t takeBookingNumber() {
+    uint64_t number;
+    do {
+        number = nextBookingNumber++;
+    } while (bookingIndex.count(number));
+    return number;
+}
 
-                Flight f;
+size_t liveBookingCount() {
+    return bookings.size() - freeBookingSlots.size();
+}
 
-                getline(ss, f.flightNo, ',');
+void clearBookings() {
+    bookings.clear();
+    bookingIndex.clear();
+    passengerBookings.clear();
+    freeBookingSlots.clear();
+    for (auto& f : catalog.details) {
+        releaseManifest(f);
+        initializeSeats(f);
+    }
+}
 
-                getline(ss, f.destination, ',');
+void addPassengerRecord(const CompactPassenger& passenger) {
+    passengerIndex[string(fixedText(passenger.id))].push_back(passengers.size());
+    passengers.push_back(passenger);
+}
 
-                getline(ss, f.dayTime, ',');
+// Every booking adds a record, so an ID that flew more than once has
+// several. A record carries its flight's destination, which ties it to the
+// passenger's booking on a flight there; of those the latest is the live one.
+CompactPassenger* findPassenger(const string& passengerId, Symbol destination) {
+    auto it = passengerIndex.find(passengerId);
+    if (it == passengerIndex.end()) return nullptr;
+
+    CompactPassenger* found = nullptr;
+    for (size_t position : it->second) {
+        CompactPassenger* record = &passengers[position];
+        if (record->destination == destination && (!found || record > found)) found = record;
+    }
+    return found;
+}
 
-                getline(ss, f.distance, ',');
+void setPassengerId(CompactPassenger& passenger, const FixedText<10>& passengerId) {
+    size_t position = &passenger - passengers.data();
+    auto it = passengerIndex.find(string(fixedText(passenger.id)));
+    if (it != passengerIndex.end()) {
+        vector<size_t>& records = it->second;
+        records.erase(remove(records.begin(), records.end(), position), records.end());
+        if (records.empty()) passengerIndex.erase(it);
+    }
 
-                getline(ss, f.plane, ',');
+    passenger.id = passengerId;
+    passengerIndex[string(fixedText(passengerId))].push_back(position);
+}
 
-                getline(ss, f.duration, ',');
+void clearPassengerRecords() {
+    passengers.clear();
+    passengerIndex.clear();
+}
 
-                ss >> f.totalSeats;
+// ===================== BANK LEDGER =====================
+// Accounts are found through bankIndex. Balances only change by appending
+// to the ledger, which also indexes each entry by account and by
+// idempotency key. Callers hold bankMutex unless noted otherwise.
+void rebuildBankIndex() {
+    bankIndex.clear();
+    bankIndex.reserve(bankRecords.size());
+    for (size_t i = 0; i < bankRecords.size(); i++) bankIndex[bankRecords[i].name] = i;
+}
 
-                ss.ignore();
+BankAccount* findAccount(const string& name) {
+    auto it = bankIndex.find(name);
+    return it != bankIndex.end() ? &bankRecords[it->second] : nullptr;
+}
 
-                ss >> f.price;
+// Takes bankMutex
+bool isPassengerInBankSystem(const string& name) {
+    lock_guard<mutex> guard(bankMutex);
+    return findAccount(name) != nullptr;
+}
 
-                f.passengerHead = nullptr;
+// Takes bankMutex
+double getPassengerBalance(const string& name) {
+    lock_guard<mutex> guard(bankMutex);
+    const BankAccount* account = findAccount(name);
+    return account ? account->balance : 0.0;
+}
 
-                initializeSeats(f);
+// Links an entry that is already reflected in the balances (snapshot load)
+void addLedgerEntry(const LedgerEntry& entry) {
+    size_t position = ledger.size();
+    ledger.push_back(entry);
+    accountHistory[entry.account].push_back(position);
+    if (!entry.idempotencyKey.empty()) ledgerKeys[entry.idempotencyKey] = position;
+}
 
-                flights.push_back(f);
+// Moves the money and records it; false if there is no such account
+bool applyLedgerEntry(LedgerEntry entry) {
+    BankAccount* account = findAccount(entry.account);
+    if (!account) return false;
 
-            }
+    account->balance += entry.amount;
+    entry.txnId = ledger.size() + 1;
+    entry.balance = account->balance;
+    addLedgerEntry(entry);
+    return true;
+}
 
-            ffile.close();
-        }
-        
+void clearLedger() {
+    ledger.clear();
+    ledgerKeys.clear();
+    accountHistory.clear();
+}
+
+// The booking an earlier payment with this key was for, or "" if the key
+// is new. Takes bankMutex.
+string paymentReference(const string& idempotencyKey) {
+    lock_guard<mutex> guard(bankMutex);
+    auto it = ledgerKeys.find(idempotencyKey);
+    return it != ledgerKeys.end() ? ledger[it->second].reference : "";
+}
+
+// Writes the account's entries oldest first. Takes bankMutex.
+void streamAccountHistory(const string& name, ostream& out) {
+    lock_guard<mutex> guard(bankMutex);
+    auto it = accountHistory.find(name);
+    if (it == accountHistory.end()) {
+        out << "No transactions for " << name << ".\n";
+        return;
+    }
+
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "\n" << left << setw(8) << "Txn" << setw(22) << "Date" << setw(12) << "Booking"
+        << setw(14) << "Amount" << "Balance\n";
+    out << fixed << setprecision(2);
+    for (size_t position : it->second) {
+        const LedgerEntry& entry = ledger[position];
+        out << setw(8) << entry.txnId << setw(22) << timeToString(entry.when) << setw(12)
+            << entry.reference << setw(14) << entry.amount << entry.balance << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// ===================== FILE HANDLING =====================
+const char* formatName(SnapshotFormat format) {
+    return format == SnapshotFormat::Binary ? "binary" : "text";
+}
 
-      ifstream pfile("passengers.txt");
+bool parseFormat(const string& name, SnapshotFormat& format) {
+    if (name == "text") format = SnapshotFormat::Text;
+    else if (name == "binary") format = SnapshotFormat::Binary;
+    else return false;
+    return true;
+}
+
+vector<string> snapshotFiles(SnapshotFormat format) {
+    if (format == SnapshotFormat::Binary) return {BINARY_SNAPSHOT_FILE};
+    return vector<string>(begin(TEXT_SNAPSHOT_FILES), end(TEXT_SNAPSHOT_FILES));
+}
 
-        if (pfile.is_open()) {
+// Writes the persisted fields of a snapshot to the CSV files plus suffix
+// and forces them to disk. Aircraft features are joined with FEATURE_SEPARATOR.
+void writeTextSnapshot(const Snapshot& snapshot, const string& suffix) {
+    ofstream ffile("flights.txt" + suffix);
+    if (!ffile.is_open()) throw runtime_error("Cannot open flights.txt for writing");
+    for (const auto& f : snapshot.flights) {
+        ffile << symbolName(f.flightNo) << "," << symbolName(f.destination) << "," << f.dayTime << ","
+              << f.distance << "," << symbolName(f.plane) << "," << f.duration << ","
+              << f.totalSeats << "," << f.price << "\n";
+    }
+    ffile.close();
+
+    ofstream pfile("passengers.txt" + suffix);
+    if (!pfile.is_open()) throw runtime_error("Cannot open passengers.txt for writing");
+    for (const auto& p : snapshot.passengers) {
+        pfile << fixedText(p.name) << "," << fixedText(p.passport) << "," << fixedText(p.id) << ","
+              << fixedText(p.contact) << "," << symbolName(p.destination) << "," << p.registrationDate << "\n";
+    }
+    pfile.close();
 
-            passengers.clear();
+    ofstream bfile("bookings.txt" + suffix);
+    if (!bfile.is_open()) throw runtime_error("Cannot open bookings.txt for writing");
+    for (const auto& b : snapshot.bookings) {
+        bfile << formatBookingId(b.number) << "," << symbolName(b.flightNo) << "," << fixedText(b.passengerId) << ","
+              << seatCodeToString(b.seat) << "," << b.bookingTime << "," << b.isPaid << "\n";
+    }
+    bfile.close();
+
+    ofstream afile("aircrafts.txt" + suffix);
+    if (!afile.is_open()) throw runtime_error("Cannot open aircrafts.txt for writing");
+    for (const auto& a : snapshot.aircrafts) {
+        afile << symbolName(a.model) << "," << a.totalSeats << ",";
+        for (size_t i = 0; i < a.features.size(); i++) {
+            if (i) afile << FEATURE_SEPARATOR;
+            afile << a.features[i];
+        }
+        afile << "\n";
+    }
+    afile.close();
 
-            string line;
+    ofstream kfile("bank.txt" + suffix);
+    if (!kfile.is_open()) throw runtime_error("Cannot open bank.txt for writing");
+    kfile << fixed << setprecision(2);
+    for (const auto& account : snapshot.bankAccounts) {
+        kfile << account.name << "," << account.balance << "\n";
+    }
+    kfile.close();
+
+    ofstream lfile("ledger.txt" + suffix);
+    if (!lfile.is_open()) throw runtime_error("Cannot open ledger.txt for writing");
+    lfile << fixed << setprecision(2);
+    for (const auto& entry : snapshot.ledger) {
+        lfile << entry.txnId << "," << entry.account << "," << entry.amount << "," << entry.balance
+              << "," << entry.when << "," << entry.reference << "," << entry.idempotencyKey << "\n";
+    }
+    lfile.close();
 
-            while (getline(pfile, line)) {
+    for (const char* name : TEXT_SNAPSHOT_FILES) syncFile(name + suffix);
+}
 
-                stringstream ss(line);
+// Runs a full checkpoint: capture, write, install, then cut the journal.
+// Called by the background checkpointer and on exit.
+void saveData() {
+    try {
 
-                Passenger p;
+        lock_guard<mutex> running(checkpointer.running);
 
-                getline(ss, p.name, ',');
+        Snapshot snapshot = captureSnapshot();
 
-                getline(ss, p.passport, ',');
+        if (snapshot.format == SnapshotFormat::Binary) {
+            writeBinarySnapshot(snapshot, string(BINARY_SNAPSHOT_FILE) + ".ckpt");
+        } else {
+            writeTextSnapshot(snapshot, ".ckpt");
+        }
+
+        installSnapshot(snapshot);
+
+        compactJournal(snapshot.journalOffset);
+
+    } catch (const exception& e) {
+
+        cout << "Error saving data: " << e.what() << "\n";
+    }
+}
+
+// Returns false if the file does not exist; an empty file maps to no data
+bool mapFile(const char* path, MappedFile& file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw runtime_error(string("Cannot stat ") + path);
+    }
+
+    file.size = static_cast<size_t>(info.st_size);
+    if (file.size > 0) {
+        void* addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw runtime_error(string("Cannot map ") + path);
+        }
+        madvise(addr, file.size, MADV_SEQUENTIAL);
+        file.data = static_cast<const char*>(addr);
+    }
+    close(fd);
+    return true;
+}
+
+size_t countRecords(const MappedFile& file) {
+    size_t count = 0;
+    const char* cursor = file.data;
+    const char* end = file.data + file.size;
+    while (cursor < end) {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        count++;
+        if (!newline) break;
+        cursor = newline + 1;
+    }
+    return count;
+}
+
+// Splits the next line into comma separated views into the mapped buffer;
+// nothing is copied. Returns false once the buffer is exhausted.
+bool nextRecord(const char*& cursor, const char* end, vector<string_view>& fields) {
+    if (cursor >= end) return false;
+
+    const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+    const char* next = lineEnd ? lineEnd + 1 : end;
+    if (!lineEnd) lineEnd = end;
+    if (lineEnd > cursor && lineEnd[-1] == '\r') lineEnd--;
+
+    fields.clear();
+    const char* start = cursor;
+    while (true) {
+        const char* comma = static_cast<const char*>(memchr(start, ',', lineEnd - start));
+        if (!comma) {
+            fields.emplace_back(start, lineEnd - start);
+            break;
+        }
+        fields.emplace_back(start, comma - start);
+        start = comma + 1;
+    }
+    cursor = next;
+    return true;
+}
+
+template <typename T>
+bool parseNumber(string_view text, T& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Rows with the wrong number of fields, unparseable numbers or values that
+// do not fit the compact records are skipped. A missing file leaves that
+// part of the state as it is.
+void loadTextSnapshot() {
+    vector<string_view> fields;
+
+    MappedFile ffile;
+    if (mapFile("flights.txt", ffile)) {
+        clearCatalog(countRecords(ffile));
+
+        const char* cursor = ffile.data;
+        while (nextRecord(cursor, ffile.data + ffile.size, fields)) {
+            FlightSchedule f;
+            if (fields.size() != 8 || !parseNumber(fields[6], f.totalSeats) ||
+                !parseNumber(fields[7], f.price)) continue;
+
+            f.flightNo = intern(fields[0]);
+            f.destination = intern(fields[1]);
+            f.dayTime = fields[2];
+            f.distance = fields[3];
+            f.plane = intern(fields[4]);
+            f.duration = fields[5];
+            addFlightToCatalog(f);
+        }
+    }
+
+    MappedFile pfile;
+    if (mapFile("passengers.txt", pfile)) {
+        clearPassengerRecords();
+
+        size_t expected = countRecords(pfile);
+        passengers.reserve(expected);
+        passengerIndex.reserve(expected);
+
+        const char* cursor = pfile.data;
+        while (nextRecord(cursor, pfile.data + pfile.size, fields)) {
+            CompactPassenger p;
+            if (fields.size() != 6 || !parseNumber(fields[5], p.registrationDate) ||
+                !setFixedText(p.name, fields[0]) || !setFixedText(p.passport, fields[1]) ||
+                !setFixedText(p.id, fields[2]) || !setFixedText(p.contact, fields[3])) continue;
+
+            p.destination = intern(fields[4]);
+            addPassengerRecord(p);
+        }
+    }
+
+    MappedFile bfile;
+    if (mapFile("bookings.txt", bfile)) {
+        clearBookings();
+
+        size_t expected = countRecords(bfile);
+        bookings.reserve(expected);
+        bookingIndex.reserve(expected);
+
+        const char* cursor = bfile.data;
+        while (nextRecord(cursor, bfile.data + bfile.size, fields)) {
+            CompactBooking b;
+            int paid = 0;
+            b.seat = fields.size() == 6 ? parseSeatCode(fields[3]) : INVALID_SEAT;
+            if (b.seat == INVALID_SEAT || !parseBookingId(fields[0], b.number) ||
+                !setFixedText(b.passengerId, fields[2]) || !parseNumber(fields[4], b.bookingTime) ||
+                !parseNumber(fields[5], paid)) continue;
+
+            b.flightNo = intern(fields[1]);
+            b.isPaid = paid != 0;
+
+            // Marks the seat as occupied and owned on the corresponding flight
+            addBooking(b);
+            linkManifestPassenger(b);
+        }
+    }
+
+    MappedFile afile;
+    if (mapFile("aircrafts.txt", afile)) {
+        aircrafts.clear();
+        aircrafts.reserve(countRecords(afile));
+
+        const char* cursor = afile.data;
+        while (nextRecord(cursor, afile.data + afile.size, fields)) {
+            Aircraft a;
+            if (fields.size() != 3 || !parseNumber(fields[1], a.totalSeats)) continue;
+
+            a.model = intern(fields[0]);
+            string_view features = fields[2];
+            while (!features.empty()) {
+                size_t split = features.find(FEATURE_SEPARATOR);
+                a.features.emplace_back(features.substr(0, split));
+                if (split == string_view::npos) break;
+                features.remove_prefix(split + 1);
+            }
+            aircrafts.push_back(a);
+        }
+    }
+
+    MappedFile kfile;
+    if (mapFile("bank.txt", kfile)) {
+        bankRecords.clear();
+        bankRecords.reserve(countRecords(kfile));
+
+        const char* cursor = kfile.data;
+        while (nextRecord(cursor, kfile.data + kfile.size, fields)) {
+            BankAccount account;
+            if (fields.size() != 2 || !parseNumber(fields[1], account.balance)) continue;
+
+            account.name = fields[0];
+            bankRecords.push_back(account);
+        }
+    }
+
+    MappedFile lfile;
+    if (mapFile("ledger.txt", lfile)) {
+        clearLedger();
+        ledger.reserve(countRecords(lfile));
+
+        const char* cursor = lfile.data;
+        while (nextRecord(cursor, lfile.data + lfile.size, fields)) {
+            LedgerEntry entry;
+            if (fields.size() != 7 || !parseNumber(fields[0], entry.txnId) ||
+                !parseNumber(fields[2], entry.amount) || !parseNumber(fields[3], entry.balance) ||
+                !parseNumber(fields[4], entry.when)) continue;
+
+            entry.account = fields[1];
+            entry.reference = fields[5];
+            entry.idempotencyKey = fields[6];
+            addLedgerEntry(entry);
+        }
+    }
+}
+
+// Loads the snapshot in the format the last checkpoint installed, then
+// replays the journal on top of it. Returns false if the data could not be read.
+bool loadData() {
+    // A checkpoint must not swap files or cut the journal halfway through a reload
+    lock_guard<mutex> running(checkpointer.running);
+    unique_lock<shared_mutex> catalogGuard(catalogMutex);
+    AllFlightsLock flightsGuard;
+    lock_guard<mutex> storeGuard(storeMutex);
+    lock_guard<mutex> bankGuard(bankMutex);
+    clearHolds();
+    try {
+        CheckpointMarker marker = readCheckpointMarker();
+        if (marker.format == SnapshotFormat::Binary) loadBinarySnapshot(BINARY_SNAPSHOT_FILE);
+        else loadTextSnapshot();
+        rebuildBankIndex();
+
+        // Numbers of bookings cancelled before the snapshot are not in it,
+        // but must still never be handed out again
+        nextBookingNumber = max(nextBookingNumber, marker.nextBookingNumber);
+
+        // Everything committed since the snapshot was written
+        replayJournal(marker.seq);
+        loadedStamps = stampDataFiles();
+
+    } catch (const exception& e) {
+
+        cout << "Error loading data: " << e.what() << "\n";
+        return false;
+
+    }
+    return true;
+}
+
+// ===================== BINARY SNAPSHOT =====================
+// snapshot.bin holds the same state as the text files. The header and the
+// section directory carry a CRC each, and every section has its own CRC
+// in the directory; all of them are checked before any state is replaced.
+// Strings shared by many records (flight numbers, destinations) are
+// stored once in the string table.
+StringRef addSnapshotString(StringTableBuilder& strings, const string& value) {
+    auto it = strings.refs.find(value);
+    if (it != strings.refs.end()) return it->second;
+
+    if (strings.bytes.size() + value.size() > numeric_limits<uint32_t>::max()) {
+        throw runtime_error("Snapshot string table is too large");
+    }
+    StringRef ref{static_cast<uint32_t>(strings.bytes.size()), static_cast<uint32_t>(value.size())};
+    strings.bytes += value;
+    strings.refs.emplace(value, ref);
+    return ref;
+}
+
+string snapshotString(string_view table, StringRef ref) {
+    if (ref.offset > table.size() || ref.length > table.size() - ref.offset) {
+        throw runtime_error("snapshot.bin has a string reference out of bounds");
+    }
+    return string(table.substr(ref.offset, ref.length));
+}
+
+void packField(char* field, size_t width, string_view value, uint8_t& spilled, int bit,
+               StringTableBuilder& strings) {
+    memset(field, 0, width);
+    if (value.size() <= width && value.find('\0') == string_view::npos) {
+        memcpy(field, value.data(), value.size());
+        return;
+    }
+    StringRef ref = addSnapshotString(strings, string(value));
+    memcpy(field, &ref, sizeof(ref));
+    spilled |= static_cast<uint8_t>(1u << bit);
+}
+
+string unpackField(const char* field, size_t width, bool spilled, string_view table) {
+    if (spilled) {
+        StringRef ref;
+        memcpy(&ref, field, sizeof(ref));
+        return snapshotString(table, ref);
+    }
+    const char* end = static_cast<const char*>(memchr(field, '\0', width));
+    return string(field, end ? end - field : width);
+}
+
+template <typename T>
+void appendRecord(string& section, const T& record) {
+    section.append(reinterpret_cast<const char*>(&record), sizeof(T));
+}
+
+void writeBinarySnapshot(const Snapshot& snapshot, const string& path) {
+    StringTableBuilder strings;
+    string flightSection, passengerSection, bookingSection, aircraftSection, bankSection, ledgerSection;
+
+    for (const auto& f : snapshot.flights) {
+        FlightRecord r{};
+        r.flightNo = addSnapshotString(strings, symbolName(f.flightNo));
+        r.destination = addSnapshotString(strings, symbolName(f.destination));
+        r.dayTime = addSnapshotString(strings, f.dayTime);
+        r.distance = addSnapshotString(strings, f.distance);
+        r.plane = addSnapshotString(strings, symbolName(f.plane));
+        r.duration = addSnapshotString(strings, f.duration);
+        r.totalSeats = f.totalSeats;
+        r.price = f.price;
+        appendRecord(flightSection, r);
+    }
+
+    // Compact fields are never wider than their record fields, so they
+    // never spill
+    for (const auto& p : snapshot.passengers) {
+        PassengerRecord r{};
+        packField(r.name, sizeof(r.name), fixedText(p.name), r.spilled, 0, strings);
+        packField(r.passport, sizeof(r.passport), fixedText(p.passport), r.spilled, 1, strings);
+        packField(r.id, sizeof(r.id), fixedText(p.id), r.spilled, 2, strings);
+        packField(r.contact, sizeof(r.contact), fixedText(p.contact), r.spilled, 3, strings);
+        r.destination = addSnapshotString(strings, symbolName(p.destination));
+        r.registrationDate = p.registrationDate;
+        appendRecord(passengerSection, r);
+    }
+
+    for (const auto& b : snapshot.bookings) {
+        BookingRecord r{};
+        r.bookingId = addSnapshotString(strings, formatBookingId(b.number));
+        r.flightNo = addSnapshotString(strings, symbolName(b.flightNo));
+        packField(r.passengerId, sizeof(r.passengerId), fixedText(b.passengerId), r.spilled, 0, strings);
+        packField(r.seatNumber, sizeof(r.seatNumber), seatCodeToString(b.seat), r.spilled, 1, strings);
+        r.isPaid = b.isPaid ? 1 : 0;
+        r.bookingTime = b.bookingTime;
+        appendRecord(bookingSection, r);
+    }
+
+    for (const auto& a : snapshot.aircrafts) {
+        string features;
+        for (size_t i = 0; i < a.features.size(); i++) {
+            if (i) features += '\n';
+            features += a.features[i];
+        }
+        AircraftRecord r{};
+        r.model = addSnapshotString(strings, symbolName(a.model));
+        r.features = addSnapshotString(strings, features);
+        r.totalSeats = a.totalSeats;
+        appendRecord(aircraftSection, r);
+    }
+
+    for (const auto& account : snapshot.bankAccounts) {
+        BankRecord r{};
+        packField(r.name, sizeof(r.name), account.name, r.spilled, 0, strings);
+        r.balance = account.balance;
+        appendRecord(bankSection, r);
+    }
+
+    for (const auto& entry : snapshot.ledger) {
+        LedgerRecord r{};
+        r.txnId = entry.txnId;
+        r.account = addSnapshotString(strings, entry.account);
+        r.reference = addSnapshotString(strings, entry.reference);
+        r.idempotencyKey = addSnapshotString(strings, entry.idempotencyKey);
+        r.amount = entry.amount;
+        r.balance = entry.balance;
+        r.when = entry.when;
+        appendRecord(ledgerSection, r);
+    }
+
+    struct SectionData {
+        uint32_t id;
+        uint32_t recordSize;
+        const string* bytes;
+    };
+    const SectionData sections[] = {
+        {SECTION_STRINGS, 1, &strings.bytes},
+        {SECTION_FLIGHTS, sizeof(FlightRecord), &flightSection},
+        {SECTION_PASSENGERS, sizeof(PassengerRecord), &passengerSection},
+        {SECTION_BOOKINGS, sizeof(BookingRecord), &bookingSection},
+        {SECTION_AIRCRAFT, sizeof(AircraftRecord), &aircraftSection},
+        {SECTION_BANK, sizeof(BankRecord), &bankSection},
+        {SECTION_LEDGER, sizeof(LedgerRecord), &ledgerSection}
+    };
+    const size_t sectionCount = sizeof(sections) / sizeof(sections[0]);
+
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+
+    vector<SectionEntry> directory(sectionCount);
+    uint64_t offset = align(sizeof(SnapshotHeader) + sectionCount * sizeof(SectionEntry));
+    for (size_t i = 0; i < sectionCount; i++) {
+        const string& bytes = *sections[i].bytes;
+        directory[i] = {sections[i].id, sections[i].recordSize, bytes.size() / sections[i].recordSize,
+                        offset, bytes.size(), crc32(bytes.data(), bytes.size()), 0};
+        offset = align(offset + bytes.size());
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.sectionCount = static_cast<uint32_t>(sectionCount);
+    header.seq = snapshot.seq;
+    header.directoryCrc = crc32(reinterpret_cast<const char*>(directory.data()),
+                                directory.size() * sizeof(SectionEntry));
+
+    string image;
+    image.reserve(offset);
+    appendRecord(image, header);
+    image.append(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(SectionEntry));
+    for (size_t i = 0; i < sectionCount; i++) {
+        image.resize(directory[i].offset, '\0');
+        image += *sections[i].bytes;
+    }
+
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) throw runtime_error("Cannot open " + path + " for writing");
+    file.write(image.data(), static_cast<streamsize>(image.size()));
+    file.close();
+    if (!file) throw runtime_error("Cannot write " + path);
+
+    syncFile(path);
+}
+
+// Records are used in place from the mapping; only the strings are copied
+// out. A section that is absent leaves that part of the state as it is.
+void loadBinarySnapshot(const char* path) {
+    MappedFile file;
+    if (!mapFile(path, file)) return;
+
+    SnapshotHeader header;
+    if (file.size < sizeof(header)) throw runtime_error("snapshot.bin is truncated");
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error("snapshot.bin is not a snapshot file");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version " + to_string(header.version));
+    }
+
+    uint64_t directorySize = uint64_t(header.sectionCount) * sizeof(SectionEntry);
+    if (directorySize > file.size - sizeof(header)) throw runtime_error("snapshot.bin is truncated");
+    const SectionEntry* directory = reinterpret_cast<const SectionEntry*>(file.data + sizeof(header));
+    if (crc32(reinterpret_cast<const char*>(directory), directorySize) != header.directoryCrc) {
+        throw runtime_error("snapshot.bin section directory is corrupt");
+    }
+
+    const uint32_t recordSizes[] = {
+        0, 1, sizeof(FlightRecord), sizeof(PassengerRecord), sizeof(BookingRecord),
+        sizeof(AircraftRecord), sizeof(BankRecord), sizeof(LedgerRecord)
+    };
+    const SectionEntry* found[SECTION_LEDGER + 1] = {};
+    for (uint32_t i = 0; i < header.sectionCount; i++) {
+        const SectionEntry& entry = directory[i];
+        if (entry.offset % 8 != 0 || entry.offset > file.size || entry.size > file.size - entry.offset) {
+            throw runtime_error("snapshot.bin has a section out of bounds");
+        }
+        if (crc32(file.data + entry.offset, entry.size) != entry.crc) {
+            throw runtime_error("snapshot.bin section " + to_string(entry.id) + " is corrupt");
+        }
+        // Sections this version does not know about are ignored
+        if (entry.id < SECTION_STRINGS || entry.id > SECTION_LEDGER) continue;
+        if (entry.recordSize != recordSizes[entry.id] || entry.recordCount * entry.recordSize != entry.size) {
+            throw runtime_error("snapshot.bin section " + to_string(entry.id) + " has an unexpected layout");
+        }
+        found[entry.id] = &entry;
+    }
+
+    string_view table;
+    if (found[SECTION_STRINGS]) {
+        table = string_view(file.data + found[SECTION_STRINGS]->offset, found[SECTION_STRINGS]->size);
+    }
+
+    if (const SectionEntry* entry = found[SECTION_FLIGHTS]) {
+        const FlightRecord* records = reinterpret_cast<const FlightRecord*>(file.data + entry->offset);
+        clearCatalog(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const FlightRecord& r = records[i];
+            FlightSchedule f;
+            f.flightNo = intern(snapshotString(table, r.flightNo));
+            f.destination = intern(snapshotString(table, r.destination));
+            f.dayTime = snapshotString(table, r.dayTime);
+            f.distance = snapshotString(table, r.distance);
+            f.plane = intern(snapshotString(table, r.plane));
+            f.duration = snapshotString(table, r.duration);
+            f.totalSeats = r.totalSeats;
+            f.price = r.price;
+            addFlightToCatalog(f);
+        }
+    }
+
+    if (const SectionEntry* entry = found[SECTION_PASSENGERS]) {
+        const PassengerRecord* records = reinterpret_cast<const PassengerRecord*>(file.data + entry->offset);
+        clearPassengerRecords();
+        passengers.reserve(entry->recordCount);
+        passengerIndex.reserve(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const PassengerRecord& r = records[i];
+            Passenger p;
+            p.name = unpackField(r.name, sizeof(r.name), r.spilled & 1, table);
+            p.passport = unpackField(r.passport, sizeof(r.passport), r.spilled & 2, table);
+            p.id = unpackField(r.id, sizeof(r.id), r.spilled & 4, table);
+            p.contact = unpackField(r.contact, sizeof(r.contact), r.spilled & 8, table);
+            p.destination = snapshotString(table, r.destination);
+            p.registrationDate = r.registrationDate;
+
+            // A value that spilled may be too long for the compact record
+            CompactPassenger record;
+            if (packPassenger(p, record)) addPassengerRecord(record);
+        }
+    }
+
+    if (const SectionEntry* entry = found[SECTION_BOOKINGS]) {
+        const BookingRecord* records = reinterpret_cast<const BookingRecord*>(file.data + entry->offset);
+        clearBookings();
+        bookings.reserve(entry->recordCount);
+        bookingIndex.reserve(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const BookingRecord& r = records[i];
+            Booking b;
+            b.bookingId = snapshotString(table, r.bookingId);
+            b.flightNo = snapshotString(table, r.flightNo);
+            b.passengerId = unpackField(r.passengerId, sizeof(r.passengerId), r.spilled & 1, table);
+            b.seatNumber = unpackField(r.seatNumber, sizeof(r.seatNumber), r.spilled & 2, table);
+            b.bookingTime = r.bookingTime;
+            b.isPaid = r.isPaid != 0;
+
+            CompactBooking record;
+            if (!packBooking(b, record)) continue;
+            addBooking(record);
+            linkManifestPassenger(record);
+        }
+    }
+
+    if (const SectionEntry* entry = found[SECTION_AIRCRAFT]) {
+        const AircraftRecord* records = reinterpret_cast<const AircraftRecord*>(file.data + entry->offset);
+        aircrafts.clear();
+        aircrafts.reserve(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const AircraftRecord& r = records[i];
+            Aircraft a;
+            a.model = intern(snapshotString(table, r.model));
+            a.totalSeats = r.totalSeats;
+            stringstream features(snapshotString(table, r.features));
+            string feature;
+            while (getline(features, feature, '\n')) a.features.push_back(feature);
+            aircrafts.push_back(a);
+        }
+    }
+
+    if (const SectionEntry* entry = found[SECTION_BANK]) {
+        const BankRecord* records = reinterpret_cast<const BankRecord*>(file.data + entry->offset);
+        bankRecords.clear();
+        bankRecords.reserve(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const BankRecord& r = records[i];
+            bankRecords.push_back({unpackField(r.name, sizeof(r.name), r.spilled & 1, table), r.balance});
+        }
+    }
+
+    if (const SectionEntry* entry = found[SECTION_LEDGER]) {
+        const LedgerRecord* records = reinterpret_cast<const LedgerRecord*>(file.data + entry->offset);
+        clearLedger();
+        ledger.reserve(entry->recordCount);
+
+        for (uint64_t i = 0; i < entry->recordCount; i++) {
+            const LedgerRecord& r = records[i];
+            addLedgerEntry({r.txnId, snapshotString(table, r.account), r.amount, r.balance, r.when,
+                            snapshotString(table, r.reference), snapshotString(table, r.idempotencyKey)});
+        }
+    }
+}
+
+// ===================== JOURNAL =====================
+// Every committed mutation is appended to journal.log as one line:
+//   seq US type US field... US crc32 LF        (US = 0x1F)
+// Appenders that arrive while a flush is in flight are written together
+// with the next write + fdatasync (group commit). Startup loads the
+// snapshot files and replays the journal on top of them; replay stops at
+// the first torn or corrupt record and cuts the file back to it.
+const char JOURNAL_SEPARATOR = '\x1f';
+
+uint32_t crc32(const char* data, size_t length) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Also used to reattach to journal.log after a reload
+void openJournal() {
+    lock_guard<mutex> guard(journal.lock);
+    if (journal.fd >= 0) close(journal.fd);
+    journal.fd = open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal.fd < 0) throw runtime_error("Cannot open journal.log for writing");
+
+    struct stat info;
+    journal.inode = fstat(journal.fd, &info) == 0 ? info.st_ino : 0;
+    journal.fileSize = static_cast<uint64_t>(lseek(journal.fd, 0, SEEK_END));
+    // After a reload memory holds only what the files hold again
+    journal.failed = false;
+}
+
+uint64_t journalAppend(const vector<string>& fields) {
+    lock_guard<mutex> guard(journal.lock);
+    uint64_t seq = journal.nextSeq++;
+
+    string payload = to_string(seq);
+    for (const auto& field : fields) {
+        payload += JOURNAL_SEPARATOR;
+        for (char c : field) payload += (c == JOURNAL_SEPARATOR || c == '\n') ? ' ' : c;
+    }
+
+    char checksum[9];
+    snprintf(checksum, sizeof(checksum), "%08x", crc32(payload.data(), payload.size()));
+    journal.pending += payload;
+    journal.pending += JOURNAL_SEPARATOR;
+    journal.pending += checksum;
+    journal.pending += '\n';
+    journal.pendingSeq = seq;
+    return seq;
+}
+
+// Writes out everything pending. Called with journal.lock held and no
+// flush in flight; the lock is dropped for the write itself. A failed write
+// may leave part of a record behind, and replay stops there, so once one
+// fails nothing is written or acknowledged until the journal is reopened.
+bool flushJournal(unique_lock<mutex>& guard) {
+    journal.flushing = true;
+    string batch;
+    batch.swap(journal.pending);
+    uint64_t batchSeq = journal.pendingSeq;
+    bool written = journal.fd >= 0 && !journal.failed;
+    guard.unlock();
+
+    for (size_t offset = 0; written && offset < batch.size();) {
+        ssize_t n = write(journal.fd, batch.data() + offset, batch.size() - offset);
+        if (n < 0) written = false;
+        else offset += static_cast<size_t>(n);
+    }
+    if (written) written = fdatasync(journal.fd) == 0;
+
+    guard.lock();
+    journal.flushing = false;
+    if (written) journal.durableSeq = max(journal.durableSeq, batchSeq);
+    else journal.failed = true;
+    if (journal.fd >= 0) journal.fileSize = static_cast<uint64_t>(lseek(journal.fd, 0, SEEK_END));
+    journal.flushed.notify_all();
+    return written;
+}
+
+// Batch mode groups many commits behind one write + fdatasync: while
+// deferJournalSync is set, journalSync() only remembers the highest seq
+// and syncDeferredJournal() waits for all of them at once.
+thread_local bool deferJournalSync = false;
+thread_local uint64_t deferredSyncSeq = 0;
+
+// Blocks until record seq is on disk. Whoever finds no flush in flight
+// writes out everything pending; the others wait for that flush.
+void journalSync(uint64_t seq) {
+    if (deferJournalSync) {
+        deferredSyncSeq = max(deferredSyncSeq, seq);
+        return;
+    }
+
+    bool large = false;
+    {
+        unique_lock<mutex> guard(journal.lock);
+        while (journal.durableSeq < seq) {
+            if (journal.failed) throw runtime_error("Cannot write journal.log");
+            if (journal.flushing) {
+                journal.flushed.wait(guard);
+                continue;
+            }
+            flushJournal(guard);
+        }
+        large = journal.fileSize >= CHECKPOINT_JOURNAL_BYTES;
+    }
+    if (large) requestCheckpoint();
+}
+
+void syncDeferredJournal() {
+    uint64_t seq = deferredSyncSeq;
+    deferredSyncSeq = 0;
+    if (seq == 0) return;
+
+    bool deferred = deferJournalSync;
+    deferJournalSync = false;
+    try {
+        journalSync(seq);
+    } catch (...) {
+        deferJournalSync = deferred;
+        throw;
+    }
+    deferJournalSync = deferred;
+}
+
+bool decodeJournalRecord(const string& line, vector<string>& fields) {
+    size_t split = line.rfind(JOURNAL_SEPARATOR);
+    if (split == string::npos || line.size() - split - 1 != 8) return false;
+
+    char checksum[9];
+    snprintf(checksum, sizeof(checksum), "%08x", crc32(line.data(), split));
+    if (line.compare(split + 1, 8, checksum) != 0) return false;
+
+    fields.clear();
+    size_t start = 0;
+    while (start <= split) {
+        size_t end = line.find(JOURNAL_SEPARATOR, start);
+        fields.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+    return fields.size() >= 2;
+}
+
+// Replay only changes state if it differs, so a record that is already
+// reflected in the snapshot files is harmless to apply again
+void applyJournalRecord(const vector<string>& fields) {
+    const string& type = fields[1];
+
+    if (type == "F+" && fields.size() == 10) {
+        FlightSchedule f;
+        f.flightNo = intern(fields[2]);
+        f.destination = intern(fields[3]);
+        f.dayTime = fields[4];
+        f.distance = fields[5];
+        f.plane = intern(fields[6]);
+        f.duration = fields[7];
+        f.totalSeats = stoi(fields[8]);
+        f.price = stof(fields[9]);
+        applyAddFlight(f);
+    } else if (type == "F-" && fields.size() == 3) {
+        applyDeleteFlight(fields[2]);
+    } else if (type == "B+" && fields.size() == 13) {
+        if (findBookingIndex(fields[2]) >= 0) return;
+
+        CompactBooking b;
+        CompactPassenger p;
+        if (decodeJournalBooking(fields, b, p)) applyBooking(b, p);
+    } else if (type == "B$" && fields.size() == 16) {
+        // Replayed on top of a snapshot that may already hold either half
+        CompactBooking b;
+        CompactPassenger p;
+        if (findBookingIndex(fields[2]) < 0 && decodeJournalBooking(fields, b, p)) applyBooking(b, p);
+        if (stoull(fields[13]) > ledger.size()) {
+            applyLedgerEntry({0, fields[8], -stod(fields[14]), 0, stoll(fields[6]), fields[2], fields[15]});
+        }
+    } else if ((type == "G+" || type == "G$") && fields.size() >= 12 &&
+               fields.size() == 12 + 6 * stoull(fields[11])) {
+        // Each member is decoded as the B+ record it would have had alone
+        string reference;
+        for (size_t at = 12; at < fields.size(); at += 6) {
+            vector<string> member = {fields[0], "B+", fields[at], fields[2], fields[at + 1], fields[at + 2],
+                fields[3], fields[4], fields[at + 3], fields[at + 4], fields[at + 5], fields[5], fields[6]};
+            CompactBooking b;
+            CompactPassenger p;
+            if (findBookingIndex(member[2]) < 0 && decodeJournalBooking(member, b, p)) applyBooking(b, p);
+            reference += (at > 12 ? " " : "") + fields[at];
+        }
+        if (type == "G$" && stoull(fields[8]) > ledger.size()) {
+            applyLedgerEntry({0, fields[7], -stod(fields[9]), 0, stoll(fields[3]), reference, fields[10]});
+        }
+    } else if (type == "B-" && fields.size() == 3) {
+        int index = findBookingIndex(fields[2]);
+        if (index >= 0) applyCancelBooking(index);
+    } else if (type == "BP" && fields.size() == 9) {
+        int index = findBookingIndex(fields[2]);
+        if (index < 0) return;
+        // Older builds accepted a postpone onto an ID already on the flight
+        if (fixedText(bookings[index].passengerId) != fields[5] &&
+            hasBookingOnFlight(fields[5], bookings[index].flightNo)) return;
+
+        Passenger p;
+        p.name = fields[3];
+        p.passport = fields[4];
+        p.id = fields[5];
+        p.contact = fields[6];
+        CompactPassenger details;
+        SeatCode seat = parseSeatCode(fields[7]);
+        if (seat != INVALID_SEAT && packPassenger(p, details)) {
+            applyPostponeBooking(index, details, seat, stoll(fields[8]));
+        }
+    } else if (type == "A+" && fields.size() == 5) {
+        Aircraft a;
+        a.model = intern(fields[2]);
+        a.totalSeats = stoi(fields[3]);
+        // Records written before FEATURE_SEPARATOR joined them used ','; a
+        // feature can contain neither
+        string joined = fields[4];
+        replace(joined.begin(), joined.end(), ',', FEATURE_SEPARATOR);
+        stringstream ss(joined);
+        string feature;
+        while (getline(ss, feature, FEATURE_SEPARATOR)) a.features.push_back(feature);
+        applyAddAircraft(a);
+    } else if (type == "A-" && fields.size() == 3) {
+        applyDeleteAircraft(fields[2]);
+    } else if (type == "$=" && fields.size() == 4) {
+        applySetBalance(fields[2], stod(fields[3]));
+    }
+}
+
+// The booking fields shared by B+ and B$ records. Returns false if they do
+// not fit the compact records.
+bool decodeJournalBooking(const vector<string>& fields, CompactBooking& record,
+                          CompactPassenger& passengerRecord) {
+    Booking booking;
+    Passenger passenger;
+    booking.bookingId = fields[2];
+    booking.flightNo = fields[3];
+    booking.passengerId = fields[4];
+    booking.seatNumber = fields[5];
+    booking.bookingTime = stoll(fields[6]);
+    booking.isPaid = fields[7] == "1";
+
+    passenger.name = fields[8];
+    passenger.passport = fields[9];
+    passenger.id = booking.passengerId;
+    passenger.contact = fields[10];
+    passenger.destination = fields[11];
+    passenger.seatNumber = booking.seatNumber;
+    passenger.registrationDate = stoll(fields[12]);
+    return packBooking(booking, record) && packPassenger(passenger, passengerRecord);
+}
+
+// Records up to coveredSeq are already in the snapshot files and are skipped
+void replayJournal(uint64_t coveredSeq) {
+    {
+        lock_guard<mutex> guard(journal.lock);
+        journal.nextSeq = max(journal.nextSeq, coveredSeq + 1);
+    }
+
+    ifstream jfile(JOURNAL_FILE, ios::binary);
+    if (!jfile.is_open()) return;
+
+    string line;
+    vector<string> fields;
+    streamoff validEnd = 0;
+    bool torn = false;
+    while (getline(jfile, line)) {
+        // A last line without its newline is a write that never completed
+        if (jfile.eof() || !decodeJournalRecord(line, fields)) {
+            torn = true;
+            break;
+        }
+
+        validEnd = jfile.tellg();
+        uint64_t seq = stoull(fields[0]);
+        if (seq <= coveredSeq) continue;
+
+        applyJournalRecord(fields);
+        lock_guard<mutex> guard(journal.lock);
+        journal.nextSeq = max(journal.nextSeq, seq + 1);
+        journal.durableSeq = max(journal.durableSeq, seq);
+    }
+    jfile.close();
+
+    if (torn && truncate(JOURNAL_FILE, validEnd) != 0) {
+        throw runtime_error("Cannot truncate torn journal.log");
+    }
+}
+
+// ===================== CHECKPOINT =====================
+// A checkpoint copies the persisted state under every lock and writes it to
+// *.ckpt files in the selected format. checkpoint.txt is then atomically
+// replaced with "<seq> installing <format>", which is the commit point: the
+// .ckpt files are renamed over the data files, "<seq> done <format>" is
+// written and the journal is cut back to the records after seq.
+// recoverCheckpoint() finishes or discards an install that was interrupted
+// by a crash.
+void syncFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Cannot open " + path + " for syncing");
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    if (!synced) throw runtime_error("Cannot sync " + path);
+}
+
+// Makes completed renames in the working directory durable
+void syncDirectory() {
+    int fd = open(".", O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// Holding every lock means no commit is between its change and its
+// journal append while the copy is taken
+Snapshot captureSnapshot() {
+    Snapshot snapshot;
+    AllFlightsLock flightsGuard;
+    lock_guard<mutex> storeGuard(storeMutex);
+    lock_guard<mutex> bankGuard(bankMutex);
+
+    snapshot.flights.reserve(catalog.size());
+    for (size_t row = 0; row < catalog.size(); row++) {
+        snapshot.flights.push_back(flightSchedule(row));
+    }
+    snapshot.passengers = passengers;
+    snapshot.bookings.reserve(liveBookingCount());
+    for (const auto& b : bookings) {
+        if (b.number) snapshot.bookings.push_back(b);
+    }
+    snapshot.aircrafts = aircrafts;
+    snapshot.bankAccounts = bankRecords;
+    snapshot.ledger = ledger;
+    snapshot.format = snapshotFormat;
+    snapshot.nextBookingNumber = nextBookingNumber;
+
+    // Everything committed so far must reach the journal file before the
+    // offset that compaction will cut at is taken
+    unique_lock<mutex> journalGuard(journal.lock);
+    while (journal.flushing) journal.flushed.wait(journalGuard);
+    if (journal.failed || (!journal.pending.empty() && !flushJournal(journalGuard))) {
+        throw runtime_error("Cannot write journal.log");
+    }
+    snapshot.seq = journal.nextSeq - 1;
+    snapshot.journalOffset = journal.fileSize;
+    return snapshot;
+}
+
+void writeCheckpointMarker(uint64_t seq, const string& status, SnapshotFormat format,
+                           uint64_t bookingNumber) {
+    string temp = string(CHECKPOINT_FILE) + ".tmp";
+    ofstream cfile(temp);
+    if (!cfile.is_open()) throw runtime_error("Cannot open checkpoint.txt for writing");
+    cfile << seq << " " << status << " " << formatName(format) << " " << bookingNumber << "\n";
+    cfile.close();
+
+    syncFile(temp);
+    if (rename(temp.c_str(), CHECKPOINT_FILE) != 0) throw runtime_error("Cannot replace checkpoint.txt");
+    syncDirectory();
+}
+
+// Markers written before the binary format existed have no format and
+// describe the text files
+CheckpointMarker readCheckpointMarker() {
+    CheckpointMarker marker;
+    string format;
+    ifstream cfile(CHECKPOINT_FILE);
+    if (cfile.is_open()) cfile >> marker.seq >> marker.status >> format >> marker.nextBookingNumber;
+    parseFormat(format, marker.format);
+    return marker;
+}
+
+void installSnapshot(const Snapshot& snapshot) {
+    writeCheckpointMarker(snapshot.seq, "installing", snapshot.format, snapshot.nextBookingNumber);
+    for (const string& name : snapshotFiles(snapshot.format)) {
+        if (rename((name + ".ckpt").c_str(), name.c_str()) != 0) {
+            throw runtime_error("Cannot replace " + name);
+        }
+    }
+    syncDirectory();
+    writeCheckpointMarker(snapshot.seq, "done", snapshot.format, snapshot.nextBookingNumber);
+    loadedStamps = stampDataFiles();
+}
+
+// Replaces journal.log with only the records written after offset
+void compactJournal(uint64_t offset) {
+    unique_lock<mutex> guard(journal.lock);
+    while (journal.flushing) journal.flushed.wait(guard);
+    if (journal.failed || (!journal.pending.empty() && !flushJournal(guard))) {
+        throw runtime_error("Cannot write journal.log");
+    }
+
+    string tail;
+    ifstream jfile(JOURNAL_FILE, ios::binary);
+    if (jfile.is_open()) {
+        jfile.seekg(static_cast<streamoff>(offset));
+        tail.assign(istreambuf_iterator<char>(jfile), istreambuf_iterator<char>());
+    }
+    jfile.close();
+
+    string temp = string(JOURNAL_FILE) + ".tmp";
+    ofstream tfile(temp, ios::binary | ios::trunc);
+    if (!tfile.is_open()) throw runtime_error("Cannot open journal.log.tmp for writing");
+    tfile << tail;
+    tfile.close();
+    syncFile(temp);
+
+    if (rename(temp.c_str(), JOURNAL_FILE) != 0) throw runtime_error("Cannot replace journal.log");
+    syncDirectory();
+
+    if (journal.fd >= 0) close(journal.fd);
+    journal.fd = open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal.fd < 0) throw runtime_error("Cannot open journal.log for writing");
+
+    struct stat info;
+    journal.inode = fstat(journal.fd, &info) == 0 ? info.st_ino : 0;
+    journal.fileSize = tail.size();
+}
+
+void recoverCheckpoint() {
+    CheckpointMarker marker = readCheckpointMarker();
+    bool installing = marker.status == "installing";
+
+    for (SnapshotFormat format : {SnapshotFormat::Text, SnapshotFormat::Binary}) {
+        for (const string& name : snapshotFiles(format)) {
+            string staged = name + ".ckpt";
+            if (access(staged.c_str(), F_OK) != 0) continue;
+
+            // Committed .ckpt files are complete; anything else is a partial write
+            if (installing && format == marker.format) rename(staged.c_str(), name.c_str());
+            else remove(staged.c_str());
+        }
+    }
+    if (installing) writeCheckpointMarker(marker.seq, "done", marker.format, marker.nextBookingNumber);
+}
+
+void requestCheckpoint() {
+    lock_guard<mutex> guard(checkpointer.wakeLock);
+    checkpointer.requested = true;
+    checkpointer.wake.notify_one();
+}
+
+// Checkpoints when the journal grows past CHECKPOINT_JOURNAL_BYTES or every
+// CHECKPOINT_INTERVAL_SECONDS, whichever comes first. In between it wakes
+// once per tick of the hold wheels, so a hold is released about when it
+// runs out rather than at the next checkpoint.
+void checkpointLoop() {
+    unique_lock<mutex> guard(checkpointer.wakeLock);
+    long long lastCheckpoint = holdClock();
+    while (!checkpointer.stop) {
+        checkpointer.wake.wait_for(guard, chrono::seconds(1),
+            [] { return checkpointer.requested || checkpointer.stop; });
+        if (checkpointer.stop) break;
+        long long now = holdClock();
+        bool due = checkpointer.requested || now - lastCheckpoint >= CHECKPOINT_INTERVAL_SECONDS;
+        checkpointer.requested = false;
+        guard.unlock();
+
+        expireHolds();
+        if (due) {
+            lastCheckpoint = now;
+            bool journalEmpty;
+            {
+                lock_guard<mutex> journalGuard(journal.lock);
+                journalEmpty = journal.fileSize == 0 && journal.pending.empty();
+            }
+            if (!journalEmpty) saveData();
+        }
+
+        guard.lock();
+    }
+}
+
+void startCheckpointer() {
+    checkpointer.stop = false;
+    checkpointer.worker = thread(checkpointLoop);
+}
+
+void stopCheckpointer() {
+    {
+        lock_guard<mutex> guard(checkpointer.wakeLock);
+        checkpointer.stop = true;
+        checkpointer.wake.notify_one();
+    }
+    if (checkpointer.worker.joinable()) checkpointer.worker.join();
+}
+
+// ===================== STATE CACHE =====================
+// The in-memory state is authoritative while the program runs: every change
+// is journaled as it is made, so menus render straight from memory. The
+// files are only read again when something other than this process changed
+// them (a snapshot file or checkpoint.txt no longer matches what was last
+// loaded or installed here, or journal.log is not the file or size this
+// process is appending to) or when an admin asks for a reload.
+FileStamp stampFile(const string& path) {
+    FileStamp stamp;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        stamp.inode = info.st_ino;
+        stamp.size = info.st_size;
+        stamp.modified = info.st_mtim;
+    }
+    return stamp;
+}
+
+bool sameStamp(const FileStamp& a, const FileStamp& b) {
+    return a.inode == b.inode && a.size == b.size &&
+           a.modified.tv_sec == b.modified.tv_sec && a.modified.tv_nsec == b.modified.tv_nsec;
+}
+
+vector<FileStamp> stampDataFiles() {
+    vector<FileStamp> stamps;
+    stamps.push_back(stampFile(CHECKPOINT_FILE));
+    for (SnapshotFormat format : {SnapshotFormat::Text, SnapshotFormat::Binary}) {
+        for (const string& name : snapshotFiles(format)) stamps.push_back(stampFile(name));
+    }
+    return stamps;
+}
+
+// Called with checkpointer.running held, so our own checkpoint is never
+// seen half installed
+bool dataChangedOnDisk() {
+    vector<FileStamp> stamps = stampDataFiles();
+    if (!equal(stamps.begin(), stamps.end(), loadedStamps.begin(), loadedStamps.end(), sameStamp)) {
+        return true;
+    }
+
+    lock_guard<mutex> guard(journal.lock);
+    if (journal.fd < 0 || journal.flushing) return false;
+    FileStamp current = stampFile(JOURNAL_FILE);
+    return current.inode != journal.inode || current.size != static_cast<off_t>(journal.fileSize);
+}
+
+bool reloadData() {
+    if (!loadData()) return false;
+    try {
+        openJournal();
+    } catch (const exception& e) {
+        cout << "Error opening journal: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void refreshState() {
+    bool changed;
+    {
+        lock_guard<mutex> running(checkpointer.running);
+        changed = dataChangedOnDisk();
+    }
+    if (changed) reloadData();
+    expireHolds();
+}
+
+// ===================== STATE CHANGES =====================
+// apply* change the in-memory state only and are shared by the menus and
+// journal replay; commit* apply the change and make it durable.
+// Only the flight's details are taken; it starts with no bookings
+bool applyAddFlight(const FlightSchedule& flight) {
+    return addFlightToCatalog(flight);
+}
+
+bool applyDeleteFlight(const string& flightNo) {
+    Flight* flight = findFlight(flightNo);
+    if (!flight) return false;
+
+    Symbol symbol = flight->flightNo;
+    dropFlightHolds(symbol);
+
+    // Walk backwards so every booking swapped into a hole was already checked
+    for (size_t i = bookings.size(); i-- > 0;) {
+        if (bookings[i].number && bookings[i].flightNo == symbol) removeBookingAt(i);
+    }
+
+    return removeFlightFromCatalog(symbol);
+}
+
+void applyBooking(const CompactBooking& booking, const CompactPassenger& passenger) {
+    Flight* flight = findFlight(booking.flightNo);
+    if (flight) addPassengerToFlight(*flight, allocateManifestNode(*flight, passenger, booking.seat));
+    addPassengerRecord(passenger);
+    addBooking(booking);
+}
+
+void applyCancelBooking(size_t position) {
+    const CompactBooking& booking = bookings[position];
+    Flight* flight = findFlight(booking.flightNo);
+    if (flight) {
+        removePassengerFromFlight(*flight, string(fixedText(booking.passengerId)));
+        releaseFlightSeat(*flight, booking.seat);
+    }
+    removeBookingAt(position);
+}
+
+// details carries the new name, passport, id and contact
+void applyPostponeBooking(size_t position, const CompactPassenger& details, SeatCode seat, time_t when) {
+    CompactBooking& booking = bookings[position];
+    Flight* flight = findFlight(booking.flightNo);
+    string passengerId(fixedText(booking.passengerId));
+
+    if (flight) {
+        if (booking.seat != seat) {
+            releaseFlightSeat(*flight, booking.seat);
+            if (seatOwnerOf(*flight, booking.seat) == static_cast<int>(position)) {
+                clearSeatOwner(*flight, booking.seat);
+            }
+        }
+        occupyFlightSeat(*flight, seat);
+        assignSeatOwner(*flight, seat, static_cast<int>(position));
+
+        // Update flight passenger list
+        ManifestNode* current = findManifestPassenger(*flight, passengerId);
+        if (current) {
+            current->passenger.name = details.name;
+            current->passenger.passport = details.passport;
+            renameManifestPassenger(*flight, current, details.id);
+            current->passenger.contact = details.contact;
+            current->passenger.registrationDate = when;
+            current->seat = seat;
+        }
+    }
+
+    // Update passenger list with new details
+    CompactPassenger* passenger = flight ? findPassenger(passengerId, catalog.destination[flight->row]) : nullptr;
+    if (passenger) {
+        passenger->name = details.name;
+        passenger->passport = details.passport;
+        setPassengerId(*passenger, details.id);
+        passenger->contact = details.contact;
+        passenger->registrationDate = when;
+    }
+
+    setBookingPassenger(position, details.id);
+    booking.seat = seat;
+    booking.bookingTime = when;
+}
+
+bool applyAddAircraft(const Aircraft& aircraft) {
+    if (findAircraft(aircraft.model)) return false;
+    aircrafts.push_back(aircraft);
+    return true;
+}
+
+bool applyDeleteAircraft(const string& model) {
+    Symbol symbol;
+    if (!findSymbol(model, symbol)) return false;
+    auto it = find_if(aircrafts.begin(), aircrafts.end(),
+        [symbol](const Aircraft& a) { return a.model == symbol; });
+    if (it == aircrafts.end()) return false;
+    aircrafts.erase(it);
+    return true;
+}
+
+// Only replayed from journals written before payments went through the ledger
+void applySetBalance(const string& name, double balance) {
+    BankAccount* account = findAccount(name);
+    if (account) account->balance = balance;
+}
+
+// A commit applies its change and appends its journal record while holding
+// the locks of everything it touches (see LOCKING), so a checkpoint, which
+// takes all of them, sees both or neither. Waiting for the disk happens
+// after they are released.
+void commitAddFlight(const FlightSchedule& flight) {
+    uint64_t seq;
+    {
+        unique_lock<shared_mutex> catalogGuard(catalogMutex);
+        AllFlightsLock flightsGuard;
+        if (!applyAddFlight(flight)) return;
+        seq = journalAppend({"F+", symbolName(flight.flightNo), symbolName(flight.destination),
+            flight.dayTime, flight.distance, symbolName(flight.plane), flight.duration,
+            to_string(flight.totalSeats),
+            to_string(flight.price)});
+    }
+    journalSync(seq);
+}
+
+void commitDeleteFlight(const string& flightNo) {
+    uint64_t seq;
+    {
+        unique_lock<shared_mutex> catalogGuard(catalogMutex);
+        AllFlightsLock flightsGuard;
+        lock_guard<mutex> storeGuard(storeMutex);
+        if (!applyDeleteFlight(flightNo)) return;
+        seq = journalAppend({"F-", flightNo});
+    }
+    journalSync(seq);
+}
+
+// A passenger with a bank account pays for the booking in the same commit:
+// the booking and the debit are applied under one set of locks and written
+// as one B$ journal record, so no crash can keep one without the other.
+// Everyone else gets a plain B+ record and pays at the counter, so a
+// payment key, which is recorded with the payment, is refused for them.
+// Whether the passenger is already on the flight is checked again under the
+// locks, as the caller's check may race another booking. The booking ID is
+// only taken once nothing else can fail, and is filled in before journaling
+// so the caller has it even if that throws. Returns "" or why nothing was
+// changed.
+string commitBooking(const Flight& flight, Booking& booking, const Passenger& passenger,
+                     const string& paymentKey) {
+    CompactPassenger passengerRecord;
+    if (!packPassenger(passenger, passengerRecord)) return "Invalid passenger details!";
+    // Packed under a stand-in ID; the real number is set once it is taken
+    Booking packed = booking;
+    packed.bookingId = formatBookingId(1);
+    CompactBooking bookingRecord;
+    if (!packBooking(packed, bookingRecord)) return "Invalid seat!";
+
+    uint64_t seq;
+    {
+        lock_guard<mutex> flightGuard(flightLock(flight.flightNo));
+        lock_guard<mutex> storeGuard(storeMutex);
+        lock_guard<mutex> bankGuard(bankMutex);
+
+        // Rows only move while every shard is held, so this one stays put
+        auto row = flightIndex.find(flight.flightNo);
+        if (row == flightIndex.end()) return "Flight not found!";
+        double price = catalog.price[row->second];
+        if (hasBookingOnFlight(passenger.id, flight.flightNo)) return "This ID is already booked on this flight!";
+
+        const BankAccount* account = findAccount(passenger.name);
+        if (!account && !paymentKey.empty()) return "Only bank account holders can use a payment key!";
+        if (account) {
+            if (!paymentKey.empty() && ledgerKeys.count(paymentKey)) return "Payment was already made!";
+            if (account->balance < price) return "Insufficient funds!";
+        }
+
+        bookingRecord.number = takeBookingNumber();
+        booking.bookingId = formatBookingId(bookingRecord.number);
+        applyBooking(bookingRecord, passengerRecord);
+        dropHold(flight.flightNo, bookingRecord.seat, passenger.id);
+
+        vector<string> record = {account ? "B$" : "B+", booking.bookingId, booking.flightNo,
+            booking.passengerId, booking.seatNumber, to_string(booking.bookingTime),
+            booking.isPaid ? "1" : "0", passenger.name, passenger.passport, passenger.contact,
+            passenger.destination, to_string(passenger.registrationDate)};
+        if (account) {
+            applyLedgerEntry({0, passenger.name, -price, 0, booking.bookingTime,
+                              booking.bookingId, paymentKey});
+            record.push_back(to_string(ledger.back().txnId));
+            record.push_back(to_string(price));
+            record.push_back(paymentKey);
+        }
+        seq = journalAppend(record);
+    }
+    journalSync(seq);
+    return "";
+}
+
+// commitBooking for a whole party on one flight: every booking and the
+// payer's single debit for all of them are applied under one acquisition of
+// the flight's locks and written as one G$ (paid from an account) or G+
+// journal record. Everything is checked before anything is applied, so an
+// error leaves the stores as they were. The debit's reference lists the
+// booking IDs, separated by spaces.
+string commitGroupBooking(const Flight& flight, vector<Booking>& group, const vector<Passenger>& party,
+                          const string& payer, const string& paymentKey) {
+    vector<CompactPassenger> passengerRecords(party.size());
+    vector<CompactBooking> bookingRecords(group.size());
+    for (size_t i = 0; i < party.size(); i++) {
+        if (!packPassenger(party[i], passengerRecords[i])) return "Invalid passenger details!";
+        Booking packed = group[i];
+        packed.bookingId = formatBookingId(1);
+        if (!packBooking(packed, bookingRecords[i])) return "Invalid seat!";
+    }
+
+    uint64_t seq;
+    {
+        lock_guard<mutex> flightGuard(flightLock(flight.flightNo));
+        lock_guard<mutex> storeGuard(storeMutex);
+        lock_guard<mutex> bankGuard(bankMutex);
+
+        auto row = flightIndex.find(flight.flightNo);
+        if (row == flightIndex.end()) return "Flight not found!";
+        double total = catalog.price[row->second] * party.size();
+        for (const Passenger& passenger : party) {
+            if (hasBookingOnFlight(passenger.id, flight.flightNo)) return "This ID is already booked on this flight!";
+        }
+
+        const BankAccount* account = findAccount(payer);
+        if (!account && !paymentKey.empty()) return "Only bank account holders can use a payment key!";
+        if (account) {
+            if (!paymentKey.empty() && ledgerKeys.count(paymentKey)) return "Payment was already made!";
+            if (account->balance < total) return "Insufficient funds!";
+        }
+
+        string reference;
+        for (size_t i = 0; i < group.size(); i++) {
+            bookingRecords[i].number = takeBookingNumber();
+            group[i].bookingId = formatBookingId(bookingRecords[i].number);
+            reference += (i ? " " : "") + group[i].bookingId;
+        }
+
+        const Booking& first = group.front();
+        vector<string> record = {account ? "G$" : "G+", first.flightNo, to_string(first.bookingTime),
+            first.isPaid ? "1" : "0", party.front().destination, to_string(party.front().registrationDate),
+            payer, "0", "0", "", to_string(group.size())};
+        for (size_t i = 0; i < group.size(); i++) {
+            applyBooking(bookingRecords[i], passengerRecords[i]);
+            dropHold(flight.flightNo, bookingRecords[i].seat, party[i].id);
+            record.insert(record.end(), {group[i].bookingId, party[i].id, group[i].seatNumber,
+                party[i].name, party[i].passport, party[i].contact});
+        }
+        if (account) {
+            applyLedgerEntry({0, payer, -total, 0, first.bookingTime, reference, paymentKey});
+            record[7] = to_string(ledger.back().txnId);
+            record[8] = to_string(total);
+            record[9] = paymentKey;
+        }
+        seq = journalAppend(record);
+    }
+    journalSync(seq);
+    return "";
+}
+
+// Returns the flight of a live booking, or 0 ("") if there is none
+Symbol flightOfBooking(const string& bookingId) {
+    lock_guard<mutex> storeGuard(storeMutex);
+    int index = findBookingIndex(bookingId);
+    return index >= 0 ? bookings[index].flightNo : 0;
+}
+
+// A booking never changes flight, so its flight's shard can be looked up
+// first; the booking is looked up again under the lock in case it was
+// cancelled in between. Returns false if the booking does not exist.
+bool commitCancelBooking(const string& bookingId) {
+    Symbol flightNo = flightOfBooking(bookingId);
+    if (!flightNo) return false;
+
+    uint64_t seq;
+    {
+        lock_guard<mutex> flightGuard(flightLock(flightNo));
+        lock_guard<mutex> storeGuard(storeMutex);
+        int index = findBookingIndex(bookingId);
+        if (index < 0) return false;
+        applyCancelBooking(index);
+        seq = journalAppend({"B-", bookingId});
+    }
+    journalSync(seq);
+    return true;
+}
+
+// details must have passed validatePassengerDetails and claimSeat
+// The new ID may not belong to another passenger on the flight: the
+// manifest and the passenger records hold one entry per ID. Returns "" or
+// why nothing was changed.
+string commitPostponeBooking(const string& bookingId, const Passenger& details) {
+    CompactPassenger record;
+    SeatCode seat = parseSeatCode(details.seatNumber);
+    if (seat == INVALID_SEAT) return "Invalid seat!";
+    if (!packPassenger(details, record)) return "Invalid passenger details!";
+
+    Symbol flightNo = flightOfBooking(bookingId);
+    if (!flightNo) return "Booking not found!";
+
+    time_t when = getCurrentTime();
+    uint64_t seq;
+    {
+        lock_guard<mutex> flightGuard(flightLock(flightNo));
+        lock_guard<mutex> storeGuard(storeMutex);
+        int index = findBookingIndex(bookingId);
+        if (index < 0) return "Booking not found!";
+        if (fixedText(bookings[index].passengerId) != details.id && hasBookingOnFlight(details.id, flightNo)) {
+            return "This ID is already booked on this flight!";
+        }
+        applyPostponeBooking(index, record, seat, when);
+        dropHold(flightNo, seat, details.id);
+        seq = journalAppend({"BP", bookingId, details.name, details.passport, details.id,
+            details.contact, details.seatNumber, to_string(when)});
+    }
+    journalSync(seq);
+    return "";
+}
+
+void commitAddAircraft(const Aircraft& aircraft) {
+    string features;
+    for (size_t i = 0; i < aircraft.features.size(); i++) {
+        if (i) features += FEATURE_SEPARATOR;
+        features += aircraft.features[i];
+    }
+
+    uint64_t seq;
+    {
+        AllFlightsLock flightsGuard;
+        if (!applyAddAircraft(aircraft)) return;
+        seq = journalAppend({"A+", symbolName(aircraft.model), to_string(aircraft.totalSeats), features});
+    }
+    journalSync(seq);
+}
+
+void commitDeleteAircraft(const string& model) {
+    uint64_t seq;
+    {
+        AllFlightsLock flightsGuard;
+        if (!applyDeleteAircraft(model)) return;
+        seq = journalAppend({"A-", model});
+    }
+    journalSync(seq);
+}
+
+// ===================== SEAT LAYOUTS =====================
+// Every flight gets the layout of its aircraft model and seat count. Models
+// in STANDARD_LAYOUTS use their definition when the seat count matches it;
+// anything else gets rows of up to ten seats (ABC|DEFG|HIJ), the last row
+// cut short, so the seat map always has exactly totalSeats seats. Layouts
+// are compiled once per (model, seats) pair. The registry's lock is only
+// held while taking the symbol table's.
+//
+// Most of the fleet flies a few fixed configurations. Those are written as
+// FleetDefinition specializations and built into FleetLayout tables at
+// compile time as well; a flight using one has its SeatLayout's fleet set,
+// and the seat functions below are instantiated for that FleetLayout, where
+// row counts and table sizes are constants. The runtime SeatLayout is still
+// compiled from the same definition, and is what everything else reads.
+constexpr SeatCode makeSeatCode(char letter, int row) {
+    return static_cast<SeatCode>((row - 1) * SEAT_LETTERS + (letter - 'A'));
+}
+
+template <>
+struct FleetDefinition<FleetModel::Boeing737> {
+    static constexpr const char* model = "Boeing 737";
+    static constexpr array<CabinSection, 2> sections{{{'J', 1, 3, "AC|DF"}, {'Y', 4, 29, "ABC|DEF"}}};
+    static constexpr array<int, 2> exitRows{{14, 15}};
+    static constexpr array<SeatCode, 2> blocked{{makeSeatCode('C', 29), makeSeatCode('D', 29)}};
+};
+
+template <>
+struct FleetDefinition<FleetModel::AirbusA320> {
+    static constexpr const char* model = "Airbus A320";
+    static constexpr array<CabinSection, 2> sections{{{'J', 1, 2, "AC|DF"}, {'Y', 3, 27, "ABC|DEF"}}};
+    static constexpr array<int, 2> exitRows{{10, 11}};
+    static constexpr array<SeatCode, 0> blocked{};
+};
+
+template <FleetModel M>
+LayoutDefinition fleetDefinition() {
+    using Definition = FleetDefinition<M>;
+    return {Definition::model,
+            vector<CabinSection>(Definition::sections.begin(), Definition::sections.end()),
+            vector<int>(Definition::exitRows.begin(), Definition::exitRows.end()),
+            vector<SeatCode>(Definition::blocked.begin(), Definition::blocked.end()), M};
+}
+
+const LayoutDefinition STANDARD_LAYOUTS[] = {
+    fleetDefinition<FleetModel::Boeing737>(),
+    fleetDefinition<FleetModel::AirbusA320>(),
+    {"Boeing 787", {{'J', 1, 6, "AC|DG|HK"}, {'W', 7, 11, "AC|DEG|HK"}, {'Y', 12, 40, "ABC|DEG|HJK"}},
+     {12, 27}, {makeSeatCode('D', 40), makeSeatCode('E', 40), makeSeatCode('G', 40)}},
+};
+
+const char* cabinName(char cabin) {
+    switch (cabin) {
+        case 'F': return "First";
+        case 'J': return "Business";
+        case 'W': return "Premium economy";
+        default: return "Economy";
+    }
+}
+
+// Whether the seats in columns left < right of a row are not side by side:
+// an aisle follows one of left .. right - 1, or a seat the section has
+// between them was blocked
+constexpr bool seatsApart(uint32_t sectionSeats, uint32_t aisleAfter, int left, int right) {
+    uint32_t between = (uint32_t(1) << right) - (uint32_t(2) << left);
+    uint32_t fromLeft = (uint32_t(1) << right) - (uint32_t(1) << left);
+    return (sectionSeats & between) || (aisleAfter & fromLeft);
+}
+
+// Most seats side by side among a row's count seats
+constexpr int widestRun(uint32_t breaks, int count) {
+    int widest = 0, run = 0;
+    for (int k = 0; k < count; k++) {
+        widest = max(widest, ++run);
+        if (breaks >> k & 1) run = 0;
+    }
+    return widest;
+}
+
+template <FleetModel M>
+constexpr int fleetRows() {
+    int rows = 0;
+    for (const auto& section : FleetDefinition<M>::sections) rows = max(rows, section.lastRow);
+    return min(rows, MAX_SEAT_ROWS);
+}
+
+// compileLayout, evaluated by the compiler
+template <FleetModel M>
+constexpr FleetLayout<fleetRows<M>()> buildFleetLayout() {
+    using Definition = FleetDefinition<M>;
+    constexpr int rows = fleetRows<M>();
+    FleetLayout<rows> layout;
+
+    int columnOf[SEAT_LETTERS] = {};
+    uint32_t usedLetters = 0;
+    for (const auto& section : Definition::sections) {
+        for (const char* c = section.seats; *c; c++) {
+            if (*c >= 'A' && *c <= 'Z') usedLetters |= uint32_t(1) << (*c - 'A');
+        }
+    }
+    for (int letter = 0; letter < SEAT_LETTERS; letter++) {
+        columnOf[letter] = -1;
+        if (!(usedLetters >> letter & 1)) continue;
+        columnOf[letter] = layout.columns;
+        layout.letters[layout.columns++] = static_cast<char>('A' + letter);
+    }
+
+    uint32_t present[rows] = {}, sectionSeats[rows] = {}, aisleAfter[rows] = {};
+    for (const auto& section : Definition::sections) {
+        uint32_t seats = 0, aisles = 0;
+        int lastColumn = -1;
+        for (const char* c = section.seats; *c; c++) {
+            if (*c == '|') {
+                if (lastColumn >= 0) aisles |= uint32_t(1) << lastColumn;
+            } else if (*c >= 'A' && *c <= 'Z') {
+                lastColumn = columnOf[*c - 'A'];
+                seats |= uint32_t(1) << lastColumn;
+            }
+        }
+        layout.aisleAfter |= aisles;
+        for (int row = max(section.firstRow, 1); row <= min(section.lastRow, rows); row++) {
+            present[row - 1] |= seats;
+            sectionSeats[row - 1] |= seats;
+            aisleAfter[row - 1] = aisles;
+            layout.rowCabin[row - 1] = section.cabin;
+        }
+    }
+    for (SeatCode code : Definition::blocked) {
+        if (code / SEAT_LETTERS < rows && columnOf[code % SEAT_LETTERS] >= 0) {
+            present[code / SEAT_LETTERS] &= ~(uint32_t(1) << columnOf[code % SEAT_LETTERS]);
+        }
+    }
+    for (int row : Definition::exitRows) {
+        if (row >= 1 && row <= rows) layout.exitRow[row - 1] = true;
+    }
+
+    for (auto& seat : layout.index) seat = NO_SEAT;
+    for (int row = 0; row < rows; row++) {
+        layout.rowStart[row] = static_cast<SeatIndex>(layout.capacity);
+        int previous = -1;
+        for (int column = 0; column < layout.columns && layout.capacity < MAX_SEATS; column++) {
+            if (!(present[row] >> column & 1)) continue;
+            if (previous >= 0 && seatsApart(sectionSeats[row], aisleAfter[row], previous, column)) {
+                layout.rowBreaks[row] |= uint32_t(1) << (layout.capacity - 1 - layout.rowStart[row]);
+            }
+            previous = column;
+            layout.index[row * SEAT_LETTERS + (layout.letters[column] - 'A')] = static_cast<SeatIndex>(layout.capacity++);
+            layout.rowColumns[row] |= uint32_t(1) << column;
+        }
+    }
+    layout.rowStart[rows] = static_cast<SeatIndex>(layout.capacity);
+    for (int row = 0; row < rows; row++) {
+        layout.widestBlock = max(layout.widestBlock, widestRun(layout.rowBreaks[row], layout.rowStart[row + 1] - layout.rowStart[row]));
+    }
+    return layout;
+}
+
+template <FleetModel M>
+constexpr FleetLayout<fleetRows<M>()> fleetLayout = buildFleetLayout<M>();
+
+static_assert(fleetLayout<FleetModel::Boeing737>.capacity == 166 &&
+              fleetLayout<FleetModel::AirbusA320>.capacity == 158,
+              "standard layouts changed size");
+
+SeatIndex layoutSeatIndex(const SeatLayout& layout, SeatCode code) {
+    if (code == INVALID_SEAT || code / SEAT_LETTERS >= layout.rows) return NO_SEAT;
+    int column = layout.columnOf[code % SEAT_LETTERS];
+    if (column < 0) return NO_SEAT;
+    return layout.grid[(code / SEAT_LETTERS) * layout.columns + column];
+}
+
+template <int Rows>
+SeatIndex layoutSeatIndex(const FleetLayout<Rows>& layout, SeatCode code) {
+    return code < Rows * SEAT_LETTERS ? layout.index[code] : NO_SEAT;
+}
+
+// The seat named seat, and its SeatCode in code. Unlike parseSeatCode this
+// rejects names that are valid but not on the aircraft.
+SeatIndex parseLayoutSeat(const SeatLayout& layout, string_view seat, SeatCode& code) {
+    code = parseSeatCode(seat);
+    return layoutSeatIndex(layout, code);
+}
+
+// parseSeatCode with the row limit of the aircraft: rows run below 100, so
+// the loop is over at most two digits
+template <int Rows>
+SeatIndex parseLayoutSeat(const FleetLayout<Rows>& layout, string_view seat, SeatCode& code) {
+    if (seat.length() < 2) return NO_SEAT;
+    unsigned letter = (seat[0] | 0x20) - 'a'; // either case
+    if (letter >= SEAT_LETTERS) return NO_SEAT;
+
+    unsigned row = 0;
+    for (size_t i = 1; i < seat.length(); i++) {
+        unsigned digit = seat[i] - '0';
+        if (digit > 9 || row > Rows) return NO_SEAT;
+        row = row * 10 + digit;
+    }
+    if (row < 1 || row > Rows) return NO_SEAT;
+
+    code = static_cast<SeatCode>((row - 1) * SEAT_LETTERS + letter);
+    return layout.index[code];
+}
+
+// Calls visit with the compile-time tables of layout's fleet model, or with
+// layout itself if it has none
+template <typename Visitor>
+auto withFleetLayout(const SeatLayout& layout, Visitor&& visit) {
+    switch (layout.fleet) {
+        case FleetModel::Boeing737: return visit(fleetLayout<FleetModel::Boeing737>);
+        case FleetModel::AirbusA320: return visit(fleetLayout<FleetModel::AirbusA320>);
+        default: return visit(layout);
+    }
+}
+
+SeatIndex seatIndexOf(const SeatLayout& layout, SeatCode code) {
+    return withFleetLayout(layout, [code](const auto& tables) { return layoutSeatIndex(tables, code); });
+}
+
+SeatIndex parseSeat(const SeatLayout& layout, string_view seat, SeatCode& code) {
+    return withFleetLayout(layout, [seat, &code](const auto& tables) { return parseLayoutSeat(tables, seat, code); });
+}
+
+SeatLayout compileLayout(const LayoutDefinition& definition) {
+    SeatLayout layout;
+    layout.standard = true;
+    layout.columnOf.fill(-1);
+
+    // Columns are every letter any section uses, in alphabetical order
+    bool usedLetter[SEAT_LETTERS] = {};
+    for (const auto& section : definition.sections) {
+        layout.rows = min(max(layout.rows, section.lastRow), MAX_SEAT_ROWS);
+        for (const char* c = section.seats; *c; c++) {
+            if (*c >= 'A' && *c <= 'Z') usedLetter[*c - 'A'] = true;
+        }
+    }
+    for (int letter = 0; letter < SEAT_LETTERS; letter++) {
+        if (!usedLetter[letter]) continue;
+        layout.columnOf[letter] = static_cast<int8_t>(layout.letters.size());
+        layout.letters += static_cast<char>('A' + letter);
+    }
+    size_t columns = layout.letters.size();
+    layout.columns = static_cast<int>(columns);
+
+    vector<bool> present(layout.rows * columns, false);
+    vector<uint32_t> aisleSeats(layout.rows, 0); // row -> bit per column next to an aisle
+    vector<uint32_t> sectionSeats(layout.rows, 0), aisleAfter(layout.rows, 0); // before blocking
+    layout.rowCabin.assign(layout.rows, 'Y');
+    layout.exitRow.assign(layout.rows, false);
+    for (const auto& section : definition.sections) {
+        uint32_t seats = 0, besideAisle = 0, aisles = 0;
+        int lastColumn = -1;
+        for (const char* c = section.seats; *c; c++) {
+            if (*c == '|') {
+                if (lastColumn >= 0) {
+                    layout.aisleAfter |= uint32_t(1) << lastColumn;
+                    besideAisle |= uint32_t(1) << lastColumn;
+                    aisles |= uint32_t(1) << lastColumn;
+                }
+            } else if (*c >= 'A' && *c <= 'Z') {
+                lastColumn = layout.columnOf[*c - 'A'];
+                seats |= uint32_t(1) << lastColumn;
+                if (c > section.seats && c[-1] == '|') besideAisle |= uint32_t(1) << lastColumn;
+            }
+        }
+        for (int row = max(section.firstRow, 1); row <= min(section.lastRow, layout.rows); row++) {
+            for (size_t column = 0; column < columns; column++) {
+                if (seats >> column & 1) present[(row - 1) * columns + column] = true;
+            }
+            aisleSeats[row - 1] = besideAisle;
+            sectionSeats[row - 1] |= seats;
+            aisleAfter[row - 1] = aisles;
+            layout.rowCabin[row - 1] = section.cabin;
+        }
+    }
+    for (SeatCode code : definition.blocked) {
+        if (code / SEAT_LETTERS >= layout.rows) continue;
+        int column = layout.columnOf[code % SEAT_LETTERS];
+        if (column >= 0) present[(code / SEAT_LETTERS) * columns + column] = false;
+    }
+    for (int row : definition.exitRows) {
+        if (row >= 1 && row <= layout.rows) layout.exitRow[row - 1] = true;
+    }
+
+    layout.grid.assign(layout.rows * columns, NO_SEAT);
+    layout.rowColumns.assign(layout.rows, 0);
+    layout.rowBreaks.assign(layout.rows, 0);
+    for (int row = 0; row < layout.rows; row++) {
+        int first = -1, last = -1;
+        for (size_t column = 0; column < columns; column++) {
+            if (!present[row * columns + column]) continue;
+            if (first < 0) first = static_cast<int>(column);
+            last = static_cast<int>(column);
+        }
+
+        layout.rowStart.push_back(static_cast<SeatIndex>(layout.capacity()));
+        int previous = -1;
+        for (size_t column = 0; column < columns && layout.capacity() < MAX_SEATS; column++) {
+            if (!present[row * columns + column]) continue;
+            if (previous >= 0 && seatsApart(sectionSeats[row], aisleAfter[row], previous, static_cast<int>(column))) {
+                layout.rowBreaks[row] |= uint32_t(1) << (layout.capacity() - 1 - layout.rowStart[row]);
+            }
+            previous = static_cast<int>(column);
+            uint8_t attributes = 0;
+            if (static_cast<int>(column) == first || static_cast<int>(column) == last) attributes |= SEAT_WINDOW;
+            if (aisleSeats[row] >> column & 1) attributes |= SEAT_AISLE;
+            if (layout.exitRow[row]) attributes |= SEAT_EXIT_ROW;
+
+            layout.grid[row * columns + column] = static_cast<SeatIndex>(layout.capacity());
+            layout.rowColumns[row] |= uint32_t(1) << column;
+            layout.codes.push_back(static_cast<SeatCode>(row * SEAT_LETTERS + (layout.letters[column] - 'A')));
+            layout.cabins.push_back(layout.rowCabin[row]);
+            layout.attributes.push_back(attributes);
+        }
+    }
+    layout.rowStart.push_back(static_cast<SeatIndex>(layout.capacity()));
+    for (int row = 0; row < layout.rows; row++) {
+        layout.widestBlock = max(layout.widestBlock, widestRun(layout.rowBreaks[row], layout.rowStart[row + 1] - layout.rowStart[row]));
+    }
+    return layout;
+}
+
+SeatLayout uniformLayout(int totalSeats) {
+    const int across = 10;
+    int seats = min(max(totalSeats, 0), MAX_SEATS);
+    int rows = (seats + across - 1) / across;
+
+    LayoutDefinition definition{"", {{'Y', 1, rows, "ABC|DEFG|HIJ"}}, {}, {}};
+    for (int column = seats % across ? seats % across : across; column < across; column++) {
+        definition.blocked.push_back(makeSeatCode(static_cast<char>('A' + column), rows));
+    }
+
+    SeatLayout layout = compileLayout(definition);
+    layout.standard = false;
+    return layout;
+}
+
+const SeatLayout* layoutFor(Symbol model, int totalSeats) {
+    lock_guard<mutex> guard(seatLayouts.lock);
+    auto key = make_pair(model, totalSeats);
+    auto it = seatLayouts.byAircraft.find(key);
+    if (it != seatLayouts.byAircraft.end()) return it->second;
+
+    const string& name = symbolName(model);
+    auto definition = find_if(begin(STANDARD_LAYOUTS), end(STANDARD_LAYOUTS),
+        [&name](const LayoutDefinition& d) { return name == d.model; });
+
+    SeatLayout layout;
+    if (definition != end(STANDARD_LAYOUTS)) layout = compileLayout(*definition);
+    if (!layout.standard || layout.capacity() != totalSeats) layout = uniformLayout(totalSeats);
+    layout.model = model;
+
+    // The compile-time tables are only used once they number every seat
+    // the way these do
+    if (layout.standard) {
+        layout.fleet = definition->fleet;
+        bool same = withFleetLayout(layout, [&layout](const auto& tables) {
+            if (tables.rows != layout.rows || tables.rowStart[tables.rows] != layout.capacity() ||
+                tables.widestBlock != layout.widestBlock) {
+                return false;
+            }
+            for (int row = 0; row < layout.rows; row++) {
+                if (tables.rowBreaks[row] != layout.rowBreaks[row]) return false;
+            }
+            for (SeatIndex seat = 0; seat < layout.capacity(); seat++) {
+                if (layoutSeatIndex(tables, layout.codes[seat]) != seat) return false;
+            }
+            return true;
+        });
+        if (!same) layout.fleet = FleetModel::None;
+    }
+
+    seatLayouts.layouts.push_back(move(layout));
+    return seatLayouts.byAircraft[key] = &seatLayouts.layouts.back();
+}
+
+// Seats of the standard layout for model, 0 if it has none
+int standardSeatCount(const string& model) {
+    auto definition = find_if(begin(STANDARD_LAYOUTS), end(STANDARD_LAYOUTS),
+        [&model](const LayoutDefinition& d) { return model == d.model; });
+    return definition != end(STANDARD_LAYOUTS) ? compileLayout(*definition).capacity() : 0;
+}
+
+// "166 seats in 29 rows: Business 12, Economy 154"
+string describeLayout(const SeatLayout& layout) {
+    string text = to_string(layout.capacity()) + " seats in " + to_string(layout.rows) + " rows:";
+    char cabin = 0;
+    int count = 0;
+    for (int seat = 0; seat <= layout.capacity(); seat++) {
+        if (seat < layout.capacity() && layout.cabins[seat] == cabin) {
+            count++;
+            continue;
+        }
+        if (count > 0) text += string(text.back() == ':' ? " " : ", ") + cabinName(cabin) + " " + to_string(count);
+        if (seat < layout.capacity()) {
+            cabin = layout.cabins[seat];
+            count = 1;
+        }
+    }
+    return text;
+}
+
+// ===================== SEAT MANAGEMENT =====================
+// Any seat name that could exist on some aircraft; whether this flight has
+// it is up to its layout (see seatIndexOf)
+SeatCode parseSeatCode(string_view seat) {
+    if (seat.length() < 2 || !isalpha(static_cast<unsigned char>(seat[0]))) return INVALID_SEAT;
+
+    int column = toupper(static_cast<unsigned char>(seat[0])) - 'A';
+    int row = 0;
+    for (size_t i = 1; i < seat.length(); i++) {
+        if (!isdigit(static_cast<unsigned char>(seat[i])) || row > MAX_SEAT_ROWS) return INVALID_SEAT;
+        row = row * 10 + (seat[i] - '0');
+    }
+
+    if (column < 0 || column >= SEAT_LETTERS || row < 1 || row > MAX_SEAT_ROWS) return INVALID_SEAT;
+    return static_cast<SeatCode>((row - 1) * SEAT_LETTERS + column);
+}
+
+string seatCodeToString(SeatCode code) {
+    return string(1, static_cast<char>('A' + code % SEAT_LETTERS)) + to_string(code / SEAT_LETTERS + 1);
+}
+
+bool isSeatOccupied(const SeatInventory& seats, SeatIndex seat) {
+    return (seats.occupied[seat / 64].load(memory_order_acquire) >> (seat % 64)) & 1;
+}
+
+// Sets the seat's bit and reports whether this call was the one that set it;
+// of any number of concurrent claims on a free seat exactly one wins
+bool tryClaimSeat(SeatInventory& seats, SeatIndex seat) {
+    uint64_t bit = uint64_t(1) << (seat % 64);
+    return !(seats.occupied[seat / 64].fetch_or(bit, memory_order_acq_rel) & bit);
+}
+
+// Reports whether the seat was taken
+bool releaseSeat(SeatInventory& seats, SeatIndex seat) {
+    uint64_t bit = uint64_t(1) << (seat % 64);
+    return seats.occupied[seat / 64].fetch_and(~bit, memory_order_acq_rel) & bit;
+}
+
+int occupiedSeatCount(const SeatInventory& seats) {
+    int count = 0;
+    for (int w = 0; w < SEAT_WORDS; w++) {
+        count += __builtin_popcountll(seats.occupied[w].load(memory_order_relaxed));
+    }
+    return count;
+}
+
+// The seat bits of a catalogued flight only change through these two, so
+// its seatsLeft always matches them. Claims take no shard lock, so the
+// count is updated atomically as well; the claimer's shared hold on
+// catalogMutex keeps the Flight, and the count in it, in place.
+bool occupyFlightSeat(Flight& flight, SeatCode code) {
+    SeatIndex seat = seatIndexOf(*flight.layout, code);
+    if (seat == NO_SEAT || !tryClaimSeat(flight.seats, seat)) return false;
+    flight.seatsLeft.value.fetch_sub(1, memory_order_relaxed);
+    return true;
+}
+
+void releaseFlightSeat(Flight& flight, SeatCode code) {
+    SeatIndex seat = seatIndexOf(*flight.layout, code);
+    if (seat != NO_SEAT && releaseSeat(flight.seats, seat)) {
+        flight.seatsLeft.value.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+int availableSeats(size_t row) {
+    return availableSeats(catalog.details[row]);
+}
+
+int availableSeats(const Flight& flight) {
+    return flight.seatsLeft.value.load(memory_order_relaxed);
+}
+
+int seatOwnerOf(const Flight& flight, SeatCode code) {
+    SeatIndex seat = seatIndexOf(*flight.layout, code);
+    return (seat < flight.seatOwner.size()) ? flight.seatOwner[seat] : -1;
+}
+
+// The owner table is only allocated once the flight gets its first booking
+void assignSeatOwner(Flight& flight, SeatCode code, int position) {
+    SeatIndex seat = seatIndexOf(*flight.layout, code);
+    if (seat == NO_SEAT) return;
+    if (flight.seatOwner.empty()) flight.seatOwner.assign(flight.layout->capacity(), -1);
+    flight.seatOwner[seat] = position;
+}
+
+void clearSeatOwner(Flight& flight, SeatCode code) {
+    SeatIndex seat = seatIndexOf(*flight.layout, code);
+    if (seat < flight.seatOwner.size()) flight.seatOwner[seat] = -1;
+}
+
+void initializeSeats(Flight& flight) {
+    flight.seats = SeatInventory();
+    flight.seatOwner.clear();
+    flight.seatsLeft.value.store(flight.totalSeats, memory_order_relaxed);
+}
+
+// Bit k set when the row's seat k is taken, counting from the left. A
+// row's seats have consecutive SeatIndexes, so this is one shift of at most
+// two bitmap words.
+template <typename Layout>
+uint32_t rowOccupancy(const Layout& layout, const SeatInventory& seats, int row) {
+    int first = layout.rowStart[row];
+    int count = layout.rowStart[row + 1] - first;
+    if (count == 0) return 0;
+
+    uint64_t bits = seats.occupied[first / 64].load(memory_order_acquire) >> (first % 64);
+    if (first % 64 + count > 64) {
+        bits |= seats.occupied[first / 64 + 1].load(memory_order_acquire) << (64 - first % 64);
+    }
+    return static_cast<uint32_t>(bits) & ((uint32_t(1) << count) - 1);
+}
+
+// Bit c set when the seat in column c of row (from 0) is taken: the row's
+// occupancy spread out over the columns it has seats in
+template <typename Layout>
+uint32_t occupiedColumns(const Layout& layout, const SeatInventory& seats, int row) {
+    uint32_t bits = rowOccupancy(layout, seats, row), taken = 0;
+    for (uint32_t columns = layout.rowColumns[row]; columns; columns &= columns - 1, bits >>= 1) {
+        if (bits & 1) taken |= columns & (~columns + 1);
+    }
+    return taken;
+}
+
+// Drawn from the layout tables: cabin and exit rows are marked at the ends
+// of a row, aisles are gaps and positions without a seat stay blank
+template <typename Layout>
+void renderSeatMap(const Layout& layout, const SeatInventory& seats, ostream& out) {
+    out << "\n\n     ";
+    for (int col = 0; col < layout.columns; col++) {
+        out << ' ' << layout.letters[col] << "  ";
+        if (layout.aisleAfter >> col & 1) out << "  ";
+    }
+    out << "\n";
+
+    for (int row = 0; row < layout.rows; row++) {
+        uint32_t present = layout.rowColumns[row];
+        uint32_t taken = occupiedColumns(layout, seats, row);
+        out << left << setw(3) << row + 1 << layout.rowCabin[row] << ' ';
+        for (int col = 0; col < layout.columns; col++) {
+            out << (!(present >> col & 1) ? "    " : (taken >> col & 1) ? "[X] " : "[ ] ");
+            if (layout.aisleAfter >> col & 1) out << "  ";
+        }
+        if (layout.exitRow[row]) out << "  EXIT";
+        out << "\n";
+    }
+    out << "\n[X] = Booked\t[ ] = Available\n";
 
-                getline(ss, p.id, ',');
+    string cabins;
+    for (char cabin : layout.rowCabin) {
+        if (cabins.find(cabin) == string::npos) cabins += cabin;
+    }
+    for (char cabin : cabins) out << cabin << " = " << cabinName(cabin) << "\t";
+    out << "\n";
+}
 
-                getline(ss, p.contact, ',');
+void displaySeatMap(const Flight& flight) {
+    cout << "\n===== SEAT MAP FOR FLIGHT " << symbolName(flight.flightNo) << " =====";
+    withFleetLayout(*flight.layout, [&flight](const auto& layout) { renderSeatMap(layout, flight.seats, cout); });
+}
 
-                getline(ss, p.destination, ',');
+bool bookSeat(Flight& flight, Passenger* passenger, const string& seatNumber) {
+    string error = claimSeat(flight, *passenger, seatNumber);
+    if (!error.empty()) {
+        cout << error << "\n";
+        return false;
+    }
+    return true;
+}
 
-                ss >> p.registrationDate;
+// ===================== SEAT ALLOCATION =====================
+// Picks seats for a SeatRequest without trying seat names. A row's free
+// seats are one bitmask (see rowOccupancy), and every seat a block of the
+// party's size could start at is found for the whole row at once with
+// shifts and ANDs. Rows are searched front to back: the best block is the
+// first that meets every preference, otherwise the first that meets the
+// most. A party that fits side by side in no row gets the frontmost free
+// seats instead; one that asked to sit apart gets single seats, those at a
+// window or aisle as asked first. The cabin is never relaxed.
+//
+// Allocation only reads the seat bitmap; claimBestSeat (see BOOKING
+// OPERATIONS) claims what it offers and searches again if it lost a seat.
+const int MAX_PARTY = 9;
+
+// Bit k set when seats k .. k + length - 1 are all free and side by side.
+// Blocks grow by doubling: a block of a + b seats is a block of a joined
+// to a block of b.
+uint32_t blockStarts(uint32_t free, uint32_t joined, int length) {
+    uint32_t starts = 0, block = free;
+    int have = 0, size = 1;
+    while (true) {
+        if (length & 1) {
+            starts = have ? starts & (block >> have) & (joined >> (have - 1)) : block;
+            have += size;
+        }
+        length >>= 1;
+        if (!length) return starts;
+        block &= (block >> size) & (joined >> (size - 1));
+        size *= 2;
+    }
+}
 
-                passengers.push_back(p);
+// Bit k set when one of seats k .. k + length - 1 is in seats. Two
+// overlapping smears of a power-of-two width cover any length.
+uint32_t blockTouches(uint32_t seats, int length) {
+    uint32_t reach = seats;
+    int span = 1;
+    while (span * 2 <= length) {
+        reach |= reach >> span;
+        span *= 2;
+    }
+    return reach | reach >> (length - span);
+}
 
+template <typename Layout>
+vector<SeatIndex> findSeats(const Layout& layout, const SeatInventory& seats, const SeatRequest& request) {
+    vector<SeatIndex> found;
+    if (request.party < 1 || request.party > MAX_PARTY) return found;
+
+    if (!request.cabin && layout.rowStart[layout.rows] - occupiedSeatCount(seats) < request.party) return found;
+
+    // Free seats of each row in the cabin, read from the bitmap the first
+    // time a search reaches the row
+    uint32_t freeSeats[MAX_SEAT_ROWS];
+    int rowsRead = 0;
+    auto freeIn = [&](int row) {
+        for (; rowsRead <= row; rowsRead++) {
+            int count = layout.rowStart[rowsRead + 1] - layout.rowStart[rowsRead];
+            bool inCabin = count > 0 && (!request.cabin || layout.rowCabin[rowsRead] == request.cabin);
+            freeSeats[rowsRead] = inCabin ? ~rowOccupancy(layout, seats, rowsRead) & ((uint32_t(1) << count) - 1) : 0;
+        }
+        return freeSeats[row];
+    };
+
+    auto windowSeats = [&layout](int row) {
+        uint32_t all = (uint32_t(1) << (layout.rowStart[row + 1] - layout.rowStart[row])) - 1;
+        return 1 | (all ^ all >> 1);
+    };
+    auto aisleSeats = [&layout](int row) {
+        uint32_t all = (uint32_t(1) << (layout.rowStart[row + 1] - layout.rowStart[row])) - 1;
+        return (layout.rowBreaks[row] | layout.rowBreaks[row] << 1) & all;
+    };
+
+    int wanted = request.window + request.aisle;
+    if (request.together && request.party <= layout.widestBlock) {
+        int bestScore = -1, bestRow = 0, bestSeat = 0;
+        for (int row = 0; row < layout.rows && bestScore < wanted; row++) {
+            uint32_t free = freeIn(row);
+            if (__builtin_popcount(free) < request.party) continue;
+            uint32_t starts = blockStarts(free, ~layout.rowBreaks[row], request.party);
+            if (!starts) continue;
+
+            uint32_t window = request.window ? starts & blockTouches(windowSeats(row), request.party) : 0;
+            uint32_t aisle = request.aisle ? starts & blockTouches(aisleSeats(row), request.party) : 0;
+            uint32_t byScore[] = {starts, window | aisle, window & aisle};
+            for (int score = wanted; score > bestScore; score--) {
+                if (!byScore[score]) continue;
+                bestScore = score;
+                bestRow = row;
+                bestSeat = __builtin_ctz(byScore[score]);
+                break;
+            }
+        }
+        if (bestScore >= 0) {
+            for (int k = 0; k < request.party; k++) {
+                found.push_back(static_cast<SeatIndex>(layout.rowStart[bestRow] + bestSeat + k));
             }
+            return found;
+        }
+    }
 
-            pfile.close();
+    // Single seats: a party that wanted to sit together is kept to the
+    // frontmost free seats, anyone else gets seats as preferred first
+    bool byPreference = wanted > 0 && !request.together;
+    for (int pass = byPreference ? 0 : 1; pass < 2; pass++) {
+        for (int row = 0; row < layout.rows && found.size() < size_t(request.party); row++) {
+            uint32_t preferred = byPreference ? (request.window ? windowSeats(row) : 0) |
+                                                (request.aisle ? aisleSeats(row) : 0) : 0;
+            uint32_t free = freeIn(row) & (pass == 0 ? preferred : ~preferred);
+            for (; free && found.size() < size_t(request.party); free &= free - 1) {
+                found.push_back(static_cast<SeatIndex>(layout.rowStart[row] + __builtin_ctz(free)));
+            }
         }
-      
-     ifstream bfile("bookings.txt");
+    }
+    if (found.size() < size_t(request.party)) found.clear(); // not enough free seats
+    return found;
+}
 
-        if (bfile.is_open()) {
+vector<SeatIndex> allocateSeats(const SeatLayout& layout, const SeatInventory& seats, const SeatRequest& request) {
+    return withFleetLayout(layout, [&seats, &request](const auto& tables) { return findSeats(tables, seats, request); });
+}
 
-            bookings.clear();
+// Words joined by '+', e.g. "window", "aisle+business" or "apart". "best"
+// asks for nothing in particular. The party size is left as it is.
+bool parseSeatRequest(const string& text, SeatRequest& request) {
+    string words = foldCase(text);
+    if (words.empty()) return false;
+
+    SeatRequest parsed;
+    parsed.party = request.party;
+    size_t start = 0;
+    while (start <= words.size()) {
+        size_t end = words.find('+', start);
+        if (end == string::npos) end = words.size();
+        string word = words.substr(start, end - start);
+        if (word == "window") parsed.window = true;
+        else if (word == "aisle") parsed.aisle = true;
+        else if (word == "apart") parsed.together = false;
+        else if (word == "first") parsed.cabin = 'F';
+        else if (word == "business") parsed.cabin = 'J';
+        else if (word == "premium") parsed.cabin = 'W';
+        else if (word == "economy") parsed.cabin = 'Y';
+        else if (word != "best") return false;
+        start = end + 1;
+    }
+    request = parsed;
+    return true;
+}
 
-            string line;
+// ===================== SEAT HOLDS =====================
+// claimSeat sets a seat's bit and places a hold on it for the passenger.
+// The hold either becomes a booking (takeHold, then the commit drops it) or
+// is given back (releaseHold) or expires. Holds are in memory only: after a
+// restart the seat bits are rebuilt from bookings, so a crash mid-booking
+// leaves no seat taken.
+long long holdClock() {
+    return chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-            while (getline(bfile, line)) {
+uint64_t holdKey(Symbol flightNo, SeatCode seat) {
+    return (uint64_t(flightNo) << 16) | seat;
+}
 
-                stringstream ss(line);
+HoldWheel& holdWheelFor(uint64_t key) {
+    return holdWheels[key % HOLD_SHARDS];
+}
 
-                Booking b;
+void placeHold(const Flight& flight, SeatCode seat, const string& passengerId) {
+    uint64_t key = holdKey(flight.flightNo, seat);
+    HoldWheel& wheel = holdWheelFor(key);
+    long long expiresAt = holdClock() + HOLD_TTL_SECONDS;
 
-                getline(ss, b.bookingId, ',');
+    lock_guard<mutex> guard(wheel.lock);
+    wheel.holds[key] = {flight.flightNo, flight.generation, seat, passengerId, expiresAt, false};
+    wheel.slots[expiresAt % HOLD_WHEEL_SLOTS].push_back(key);
+}
 
-                getline(ss, b.flightNo, ',');
+// A seat whose hold has run out but was not swept yet goes straight to the
+// next passenger who asks for it, bit still set
+bool takeOverExpiredHold(const Flight& flight, SeatCode seat, const string& passengerId) {
+    uint64_t key = holdKey(flight.flightNo, seat);
+    HoldWheel& wheel = holdWheelFor(key);
+    long long now = holdClock();
+
+    lock_guard<mutex> guard(wheel.lock);
+    auto it = wheel.holds.find(key);
+    if (it == wheel.holds.end() || it->second.generation != flight.generation || it->second.taken ||
+        it->second.expiresAt > now) return false;
+
+    it->second.passengerId = passengerId;
+    it->second.expiresAt = now + HOLD_TTL_SECONDS;
+    wheel.slots[it->second.expiresAt % HOLD_WHEEL_SLOTS].push_back(key);
+    return true;
+}
 
-                getline(ss, b.passengerId, ',');
+// Stops the passenger's hold from expiring while it is paid for and
+// committed; false if it expired and went to someone else or was swept
+bool takeHold(Symbol flightNo, SeatCode seat, const string& passengerId) {
+    uint64_t key = holdKey(flightNo, seat);
+    HoldWheel& wheel = holdWheelFor(key);
 
-                getline(ss, b.seatNumber, ',');
+    lock_guard<mutex> guard(wheel.lock);
+    auto it = wheel.holds.find(key);
+    if (it == wheel.holds.end() || it->second.passengerId != passengerId) return false;
+    it->second.taken = true;
+    return true;
+}
 
-                ss >> b.bookingTime;
+// Removes the passenger's hold; true if there was one, in which case the
+// caller owns the seat bit and must clear it
+bool releaseHold(Symbol flightNo, SeatCode seat, const string& passengerId) {
+    uint64_t key = holdKey(flightNo, seat);
+    HoldWheel& wheel = holdWheelFor(key);
 
-                ss.ignore();
+    lock_guard<mutex> guard(wheel.lock);
+    auto it = wheel.holds.find(key);
+    if (it == wheel.holds.end() || it->second.passengerId != passengerId) return false;
+    wheel.holds.erase(it);
+    return true;
+}
 
-                ss >> b.isPaid;
+// Called by a commit once the held seat belongs to a booking
+void dropHold(Symbol flightNo, SeatCode seat, const string& passengerId) {
+    releaseHold(flightNo, seat, passengerId);
+}
 
-                bookings.push_back(b);
+// The flight's seats are going away, so its holds must not release bits of
+// a flight later added under the same number
+void dropFlightHolds(Symbol flightNo) {
+    for (auto& wheel : holdWheels) {
+        lock_guard<mutex> guard(wheel.lock);
+        for (auto it = wheel.holds.begin(); it != wheel.holds.end();) {
+            if (it->second.flightNo == flightNo) it = wheel.holds.erase(it);
+            else ++it;
+        }
+    }
+}
 
+// A reload rebuilds every seat from bookings
+void clearHolds() {
+    for (auto& wheel : holdWheels) {
+        lock_guard<mutex> guard(wheel.lock);
+        wheel.holds.clear();
+        for (auto& slot : wheel.slots) slot.clear();
+    }
+}
 
+// Unlinks every hold whose time is up, then clears the seat bits under the
+// flight's shard lock, which keeps the Flight in place. Between the two
+// steps the seat still looks taken, so nobody else can claim it early. The
+// flight may also have been deleted and added again, or reloaded, in
+// between; a hold only clears a bit of the Flight it was placed on.
+void expireHolds() {
+    long long now = holdClock();
+    vector<SeatHold> expired;
+
+    for (auto& wheel : holdWheels) {
+        lock_guard<mutex> guard(wheel.lock);
+        // After a full turn of idle time every slot is due once
+        long long first = max(wheel.tick + 1, now - HOLD_WHEEL_SLOTS + 1);
+        for (long long tick = first; tick <= now; tick++) {
+            vector<uint64_t>& slot = wheel.slots[tick % HOLD_WHEEL_SLOTS];
+            size_t kept = 0;
+            for (uint64_t key : slot) {
+                auto it = wheel.holds.find(key);
+                // Converted, released, or re-placed into another slot
+                if (it == wheel.holds.end() || it->second.taken ||
+                    it->second.expiresAt % HOLD_WHEEL_SLOTS != tick % HOLD_WHEEL_SLOTS) continue;
+
+                if (it->second.expiresAt > now) {
+                    slot[kept++] = key; // due in a later turn of the wheel
+                } else {
+                    expired.push_back(it->second);
+                    wheel.holds.erase(it);
+                }
+            }
+            slot.resize(kept);
+        }
+        wheel.tick = now;
+    }
 
-                // Update seatMap for the corresponding flight
+    for (const auto& hold : expired) {
+        lock_guard<mutex> guard(flightLock(hold.flightNo));
+        Flight* flight = findFlight(hold.flightNo);
+        if (flight && flight->generation == hold.generation) releaseFlightSeat(*flight, hold.seat);
+    }
+}
 
-                auto flight = find_if(flights.begin(), flights.end(),
+// ===================== PASSENGER LIST MANAGEMENT =====================
+// The manifest keeps its tail and an index by passenger ID, so appending,
+// finding and unlinking a passenger never walk the list
+void addPassengerToFlight(Flight& flight, ManifestNode* node) {
+    node->next = nullptr;
+    node->prev = flight.passengerTail;
+
+    if (flight.passengerTail) flight.passengerTail->next = node;
+    else flight.passengerHead = node;
+    flight.passengerTail = node;
+    flight.manifestIndex[string(fixedText(node->passenger.id))] = node;
+}
 
-                    [&b](const Flight& f) { return f.flightNo == b.flightNo; });
+ManifestNode* findManifestPassenger(Flight& flight, const string& passengerId) {
+    auto it = flight.manifestIndex.find(passengerId);
+    return it != flight.manifestIndex.end() ? it->second : nullptr;
+}
 
-                if (flight != flights.end()) {
+// Keeps the index in step when a postponement changes the passenger's ID
+// The new ID must not be on the flight yet (see commitPostponeBooking)
+void renameManifestPassenger(Flight& flight, ManifestNode* node, const FixedText<10>& passengerId) {
+    if (fixedText(node->passenger.id) == fixedText(passengerId)) return;
+    assert(!flight.manifestIndex.count(string(fixedText(passengerId))));
+    flight.manifestIndex.erase(string(fixedText(node->passenger.id)));
+    node->passenger.id = passengerId;
+    flight.manifestIndex[string(fixedText(passengerId))] = node;
+}
 
-                    if (flight->seatMap.find(b.seatNumber) != flight->seatMap.end()) {
+void removePassengerFromFlight(Flight& flight, const string& passengerId) {
+    ManifestNode* node = findManifestPassenger(flight, passengerId);
+    if (!node) return;
 
-                        flight->seatMap[b.seatNumber] = true;
+    if (node->prev) node->prev->next = node->next;
+    else flight.passengerHead = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else flight.passengerTail = node->prev;
+    flight.manifestIndex.erase(passengerId);
 
-                        flight->totalSeats--;
+    releaseFlightSeat(flight, node->seat);
+    freeManifestNode(flight, node);
+}
 
-                    }
+// Rebuilds a manifest entry for a booking loaded from the snapshot files
+void linkManifestPassenger(const CompactBooking& booking) {
+    Flight* flight = findFlight(booking.flightNo);
+    if (!flight) return;
+    CompactPassenger* record = findPassenger(string(fixedText(booking.passengerId)), catalog.destination[flight->row]);
+    if (!record) return;
 
-                }
+    addPassengerToFlight(*flight, allocateManifestNode(*flight, *record, booking.seat));
+}
 
-            }
+// The first slab is sized for the flight's seats, so a flight that never
+// has more passengers than seats keeps its whole manifest in one block
+ManifestNode* allocateManifestNode(Flight& flight, const CompactPassenger& passenger, SeatCode seat) {
+    ManifestPool& pool = flight.manifestPool;
+    ManifestNode* node = pool.freeList;
+    if (node) {
+        pool.freeList = node->next;
+    } else {
+        if (pool.used == pool.slabSize) {
+            pool.slabSize = max<size_t>(flight.totalSeats, MANIFEST_MIN_SLAB);
+            pool.slabs.push_back(make_unique<ManifestNode[]>(pool.slabSize));
+            pool.used = 0;
+        }
+        node = &pool.slabs.back()[pool.used++];
+    }
+    node->passenger = passenger; // reuses the destination buffer of a recycled node
+    node->seat = seat;
+    return node;
+}
 
-            bfile.close();
+void freeManifestNode(Flight& flight, ManifestNode* node) {
+    node->prev = nullptr;
+    node->next = flight.manifestPool.freeList;
+    flight.manifestPool.freeList = node;
+}
 
-        }
+// Frees every node of the flight at once
+void releaseManifest(Flight& flight) {
+    flight.manifestPool = ManifestPool();
+    flight.manifestIndex.clear();
+    flight.passengerHead = nullptr;
+    flight.passengerTail = nullptr;
+}
 
-    } catch (const exception& e) {
+// ===================== BOOKING OPERATIONS =====================
+// The non-interactive core of booking, shared by the menus and batch mode.
+// Functions returning string give "" on success, otherwise the message
+// explaining why nothing was changed.
+// Claiming is a single atomic operation on the seat's word, so claims on
+// the same flight never wait for each other or for a commit in progress.
+// The caller holds catalogMutex shared, which keeps flight in place.
+// Every booked seat keeps its bit set, so a set bit also covers seats that
+// are owned by a booking.
+string claimSeat(Flight& flight, Passenger& passenger, const string& seatNumber) {
+    if (seatNumber.length() < 2 || !isalpha(static_cast<unsigned char>(seatNumber[0])) ||
+        !isdigit(static_cast<unsigned char>(seatNumber[1]))) {
+        return "Invalid seat format! Use format like A1, B2, etc.";
+    }
 
-        cout << "Error loading data: " << e.what() << "\n";
+    SeatCode code;
+    if (parseSeat(*flight.layout, seatNumber, code) == NO_SEAT) return "Seat doesn't exist on this aircraft!";
 
+    if (occupyFlightSeat(flight, code)) {
+        placeHold(flight, code, passenger.id);
+    } else if (!takeOverExpiredHold(flight, code, passenger.id)) {
+        return "Seat already booked! Please choose another seat.";
     }
 
+    passenger.seatNumber = seatCodeToString(code);
+    return "";
 }
 
-// ===================== SEAT MANAGEMENT =====================
-void initializeSeats(Flight& flight) {
-    flight.seatMap.clear();
-    for (int row = 1; row <= 10; row++) {
-        for (char col = 'A'; col <= 'J'; col++) {
-            string seat = string(1, col) + to_string(row);
-            flight.seatMap[seat] = false;
-        }
+// claimSeat for the seat allocateSeats picks. If another claim takes that
+// seat first the search runs again, at most once per seat on the flight.
+string claimBestSeat(Flight& flight, Passenger& passenger, SeatRequest request) {
+    request.party = 1;
+    for (int attempt = 0; attempt < flight.totalSeats; attempt++) {
+        vector<SeatIndex> found = allocateSeats(*flight.layout, flight.seats, request);
+        if (found.empty()) break;
+        if (claimSeat(flight, passenger, seatCodeToString(flight.layout->codes[found[0]])).empty()) return "";
     }
+    if (request.cabin) return string("No seats available in ") + cabinName(request.cabin) + "!";
+    return "No seats available!";
 }
 
-void displaySeatMap(const Flight& flight) {
-    cout << "\n===== SEAT MAP FOR FLIGHT " << flight.flightNo << " =====";
-    cout << "\n\n  ";
-    for (char col = 'A'; col <= 'J'; col++) {
-        cout << setw(4) << col;
+// Gives back a seat claimed for a booking that did not go through. A hold
+// that already expired is left alone: its seat may be someone else's now.
+void abandonSeat(Flight& flight, const Passenger& passenger) {
+    SeatCode code = parseSeatCode(passenger.seatNumber);
+    if (code != INVALID_SEAT && releaseHold(flight.flightNo, code, passenger.id)) {
+        releaseFlightSeat(flight, code);
     }
-    cout << "\n";
+}
 
-    for (int row = 1; row <= 10; row++) {
-        cout << setw(2) << row;
-        for (char col = 'A'; col <= 'J'; col++) {
-            string seat = string(1, col) + to_string(row);
-            cout << setw(4) << (flight.seatMap.at(seat) ? "[X]" : "[ ]");
-        }
-        cout << "\n";
-    }
-    cout << "\n[X] = Booked\t[ ] = Available\n";
+string validatePassengerDetails(const Passenger& passenger) {
+    if (!validateInput(passenger.name)) return "Invalid input for name!";
+    if (!validatePassport(passenger.passport)) return "Invalid input for passport!";
+    if (!validateID(passenger.id)) return "Invalid input for ID!";
+    if (!validatePhone(passenger.contact)) return "Invalid input for phone!";
+    return "";
 }
 
-bool bookSeat(Flight& flight, Passenger* passenger, const string& seatNumber) {
-    string upperSeat = seatNumber;
-    transform(upperSeat.begin(), upperSeat.end(), upperSeat.begin(), ::toupper);
+// Pays for and records the booking in one commit (see commitBooking)
+string completeBooking(const Flight& flight, const Passenger& passenger, Booking& booking,
+                       const string& paymentKey) {
+    booking.flightNo = symbolName(flight.flightNo);
+    booking.passengerId = passenger.id;
+    booking.seatNumber = passenger.seatNumber;
+    booking.bookingTime = getCurrentTime();
+    booking.isPaid = true;
+
+    string error = commitBooking(flight, booking, passenger, paymentKey);
+    if (!error.empty()) return error;
+
+    lock_guard<mutex> guard(storeMutex);
+    userQueue.push(passenger.id);
+    return "";
+}
 
-    if (upperSeat.length() < 2 || !isalpha(upperSeat[0]) || !isdigit(upperSeat[1])) {
-        cout << "Invalid seat format! Use format like A1, B2, etc.\n";
-        return false;
+// Turns the seat claimSeat held for the passenger into a paid booking. The
+// hold is taken before paying, so a passenger is never charged for a seat
+// that expired in the meantime. paymentKey, if not empty, makes a retried
+// payment fail instead of charging twice.
+string bookHeldSeat(Flight& flight, const Passenger& passenger, Booking& booking,
+                    const string& paymentKey) {
+    if (!takeHold(flight.flightNo, parseSeatCode(passenger.seatNumber), passenger.id)) {
+        return "Seat hold expired! Please book again.";
     }
 
-    if (flight.seatMap.find(upperSeat) == flight.seatMap.end()) {
-        cout << "Seat doesn't exist on this aircraft!\n";
-        return false;
-    }
+    string error = completeBooking(flight, passenger, booking, paymentKey);
+    if (!error.empty()) abandonSeat(flight, passenger);
+    return error;
+}
 
-    if (flight.seatMap[upperSeat]) {
-        cout << "Seat already booked! Please choose another seat.\n";
-        return false;
+// The checks bookGroup's callers make before claiming any seat. Returns ""
+// or what is wrong with the party.
+string validateGroup(const Flight& flight, const vector<Passenger>& party) {
+    if (party.empty() || party.size() > static_cast<size_t>(MAX_PARTY)) {
+        return "Party size must be 1 to " + to_string(MAX_PARTY) + "!";
+    }
+    for (size_t i = 0; i < party.size(); i++) {
+        string error = validatePassengerDetails(party[i]);
+        if (!error.empty()) return error;
+        for (size_t j = 0; j < i; j++) {
+            if (party[j].id == party[i].id) return "The same ID appears twice in the group!";
         }
+        if (isPassengerOnFlight(party[i].id, flight.flightNo)) return "This ID is already booked on this flight!";
+    }
+    return "";
+}
 
+// Claims a seat for every member of the party or for none of them. choice
+// is either preferences (see parseSeatRequest), for which allocateSeats
+// places the whole party, or one seat per member separated by commas. A
+// party that loses one of its seats to another claim gives back the rest
+// and searches again, at most once per seat on the flight.
+string claimGroupSeats(Flight& flight, vector<Passenger>& party, const string& choice) {
+    SeatRequest request;
+    bool preferences = parseSeatRequest(choice, request);
+    vector<string> seats;
+    if (!preferences) {
+        stringstream ss(choice);
+        string seat;
+        while (getline(ss, seat, ',')) seats.push_back(seat);
+        if (seats.size() != party.size()) return "Choose one seat for each passenger!";
+    }
+    request.party = static_cast<int>(party.size());
+
+    for (int attempt = 0; attempt < flight.totalSeats; attempt++) {
+        if (preferences) {
+            vector<SeatIndex> found = allocateSeats(*flight.layout, flight.seats, request);
+            if (found.empty()) break;
+            seats.clear();
+            for (SeatIndex seat : found) seats.push_back(seatCodeToString(flight.layout->codes[seat]));
+        }
 
+        string error;
+        size_t claimed = 0;
+        while (claimed < party.size() && (error = claimSeat(flight, party[claimed], seats[claimed])).empty()) {
+            claimed++;
+        }
+        if (claimed == party.size()) return "";
 
-    // Check if seat is already booked in bookings for this flight
-
-    for (const auto& booking : bookings) {
+        abandonGroupSeats(flight, vector<Passenger>(party.begin(), party.begin() + claimed));
+        if (!preferences) return error;
+    }
+    if (request.cabin) return string("Not enough seats available in ") + cabinName(request.cabin) + "!";
+    return "Not enough seats available!";
+}
 
-        if (booking.flightNo == flight.flightNo && booking.seatNumber == upperSeat) {
+void abandonGroupSeats(Flight& flight, const vector<Passenger>& party) {
+    for (const Passenger& passenger : party) abandonSeat(flight, passenger);
+}
 
-            cout << "Seat already reserved in booking system! Please choose another seat.\n";
+// bookHeldSeat for a party whose seats claimGroupSeats holds: every hold is
+// taken, then the bookings and the payer's one payment for all of them go
+// through in a single commit (see commitGroupBooking). If any hold expired
+// or the commit fails, every seat is given back and nobody is booked.
+string bookHeldGroup(Flight& flight, const vector<Passenger>& party, const string& payer,
+                     vector<Booking>& group, const string& paymentKey) {
+    for (const Passenger& passenger : party) {
+        if (!takeHold(flight.flightNo, parseSeatCode(passenger.seatNumber), passenger.id)) {
+            abandonGroupSeats(flight, party);
+            return "Seat hold expired! Please book again.";
+        }
+    }
 
-            return false;
+    group.assign(party.size(), Booking());
+    time_t now = getCurrentTime();
+    for (size_t i = 0; i < party.size(); i++) {
+        group[i].flightNo = symbolName(flight.flightNo);
+        group[i].passengerId = party[i].id;
+        group[i].seatNumber = party[i].seatNumber;
+        group[i].bookingTime = now;
+        group[i].isPaid = true;
+    }
 
-        }
+    string error = commitGroupBooking(flight, group, party, payer, paymentKey);
+    if (!error.empty()) {
+        abandonGroupSeats(flight, party);
+        return error;
     }
 
-    flight.seatMap[upperSeat] = true;
-    passenger->seatNumber = upperSeat;
-    return true;
+    lock_guard<mutex> guard(storeMutex);
+    for (const Passenger& passenger : party) userQueue.push(passenger.id);
+    return "";
 }
 
-// ===================== PASSENGER LIST MANAGEMENT =====================
-void addPassengerToFlight(Flight& flight, Passenger* passenger) {
-    passenger->next = nullptr;
-    passenger->prev = nullptr;
-    
-    if (!flight.passengerHead) {
-        flight.passengerHead = passenger;
-    } else {
-        Passenger* current = flight.passengerHead;
-        while (current->next) {
-            current = current->next;
-        }
-        current->next = passenger;
-        passenger->prev = current;
+// Moves a booking to the seat claimSeat held for details.seatNumber
+string postponeToHeldSeat(Flight& flight, const string& bookingId, const Passenger& details) {
+    if (!takeHold(flight.flightNo, parseSeatCode(details.seatNumber), details.id)) {
+        return "Seat hold expired! Please book again.";
     }
-    flight.totalSeats--;
+    string error = commitPostponeBooking(bookingId, details);
+    if (!error.empty()) abandonSeat(flight, details);
+    return error;
 }
 
-void removePassengerFromFlight(Flight& flight, const string& passengerId) {
-    Passenger* current = flight.passengerHead;
-    while (current) {
-        if (current->id == passengerId) {
-            if (current->prev) current->prev->next = current->next;
-            if (current->next) current->next->prev = current->prev;
-            if (current == flight.passengerHead) flight.passengerHead = current->next;
-            
-            flight.seatMap[current->seatNumber] = false;
-            flight.totalSeats++;
-            delete current;
-            return;
-        }
-        current = current->next;
-    }
+// The flight of the booking, if it belongs to passengerId. Takes storeMutex.
+string findOwnedBooking(const string& bookingId, const string& passengerId, Symbol& flightNo) {
+    lock_guard<mutex> guard(storeMutex);
+    int position = findBookingIndex(bookingId);
+    if (position < 0) return "Booking not found!";
+    if (fixedText(bookings[position].passengerId) != passengerId) return "Invalid passenger ID! Verification failed.";
+    flightNo = bookings[position].flightNo;
+    return "";
+}
+
+string cancelBookingById(const string& bookingId) {
+    if (!commitCancelBooking(bookingId)) return "Booking not found!";
+    return "";
 }
 
 // ===================== FLIGHT FUNCTIONS =====================
 void viewAllFlights() {
-    loadData();
     cout << "\n===== AVAILABLE FLIGHTS =====";
     cout << left << setw(8) << "\nCode" << setw(15) << "Destination" 
          << setw(14) << "Departure" << setw(10) << "Distance"
          << setw(10) << "Duration" << setw(12) << "Aircraft" 
          << setw(6) << "Seats" << "Price\n";
     
-    for (const auto& f : flights) {
-        cout << setw(8) << f.flightNo << setw(15) << f.destination 
+    // Timetable order, sorted on the departure column alone; flights whose
+    // day/time does not parse (-1) follow in catalog order
+    vector<size_t> order(catalog.size());
+    for (size_t row = 0; row < order.size(); row++) order[row] = row;
+    stable_sort(order.begin(), order.end(), [](size_t a, size_t b) {
+        return static_cast<uint32_t>(catalog.departure[a]) < static_cast<uint32_t>(catalog.departure[b]);
+    });
+
+    for (size_t row : order) {
+        const Flight& f = catalog.details[row];
+        cout << setw(8) << symbolName(catalog.flightNo[row]) << setw(15) << symbolName(catalog.destination[row]) 
              << setw(14) << f.dayTime << setw(10) << f.distance
-             << setw(10) << f.duration << setw(12) << f.plane 
-             << setw(6) << f.totalSeats << "$" << f.price << "\n";
+             << setw(10) << f.duration << setw(12) << symbolName(f.plane) 
+             << setw(6) << availableSeats(row) << "$" << catalog.price[row] << "\n";
     }
 }
 
@@ -495,26 +4333,33 @@ void searchByDestination() {
     cout << "Enter destination: ";
      cin.ignore(numeric_limits<streamsize>::max(), '\n');
     getline(cin, dest);
-    transform(dest.begin(), dest.end(), dest.begin(), ::tolower);
 
     cout << "\n===== SEARCH RESULTS =====\n";
-    bool found = false;
-    for (const auto& f : flights) {
-        string fdest = f.destination;
-        transform(fdest.begin(), fdest.end(), fdest.begin(), ::tolower);
-        if (fdest.find(dest) != string::npos) {
-            cout << "Flight: " << f.flightNo << " | " << f.destination 
-                 << " | " << f.dayTime << " | " << f.duration 
-                 << " | Seats: " << f.totalSeats << " | Price: $" << f.price << "\n";
-            found = true;
-        }
+    vector<size_t> rows = searchDestinations(dest);
+    for (size_t row : rows) {
+        const Flight& f = catalog.details[row];
+        cout << "Flight: " << symbolName(catalog.flightNo[row]) << " | " << symbolName(catalog.destination[row]) 
+             << " | " << f.dayTime << " | " << f.duration 
+             << " | Seats: " << availableSeats(row) << " | Price: $" << catalog.price[row] << "\n";
     }
-    if (!found) cout << "No flights found!\n";
+    if (rows.empty()) cout << "No flights found!\n";
 }
 
 // ===================== BOOKING FUNCTIONS =====================
+// The menus below hold catalogMutex only for the steps that use the flight,
+// never while waiting for input, and look it up again for each step. Locks
+// catalogGuard; nullptr, once said so, if the flight was deleted meanwhile.
+Flight* lockFlight(shared_lock<shared_mutex>& catalogGuard, const string& flightNo) {
+    catalogGuard.lock();
+    Flight* flight = findFlight(flightNo);
+    if (!flight) cout << "Flight not found!\n";
+    return flight;
+}
+
 void bookFlight() {
+    shared_lock<shared_mutex> catalogGuard(catalogMutex);
     viewAllFlights();
+    catalogGuard.unlock();
     string flightNo;
     cout << "\nEnter flight number: ";
     cin >> flightNo;
@@ -531,20 +4376,18 @@ if (cin.fail()) {
     }
 
     
-    auto flightIt = find_if(flights.begin(), flights.end(), 
-        [&flightNo](const Flight& f) { return f.flightNo == flightNo; });
+    Flight* flight = lockFlight(catalogGuard, flightNo);
     
-    if (flightIt == flights.end()) {
-        cout << "Flight not found!\n";
-        return;
-    }
+    if (!flight) return;
 
-    if (flightIt->totalSeats <= 0) {
+    if (availableSeats(*flight) <= 0) {
         cout << "No seats available!\n";
         return;
     }
 
-    displaySeatMap(*flightIt);
+    displaySeatMap(*flight);
+    Symbol flightSymbol = flight->flightNo;
+    catalogGuard.unlock();
 
      unique_ptr<Passenger> p = make_unique<Passenger>();
 
@@ -593,11 +4436,7 @@ if (cin.fail()) {
 
         // Check for duplicate ID on this flight
 
-        if (any_of(bookings.begin(), bookings.end(), 
-
-            [&p, &flightNo](const Booking& b) { 
-
-                return b.passengerId == p->id && b.flightNo == flightNo; })) {
+        if (isPassengerOnFlight(p->id, flightSymbol)) {
 
             cout << "This ID is already booked on this flight!\n";
 
@@ -621,13 +4460,13 @@ if (cin.fail()) {
         }
     } while (!validatePhone(p->contact));
 
-    p->destination = flightIt->destination;
     p->registrationDate = getCurrentTime();
 
     string seat;
+    double price = 0;
     bool seatBooked = false;
     while (!seatBooked) {
-        cout << "Choose your seat (e.g., A1, B3): ";
+        cout << "Choose your seat (e.g., A1, B3), or best, window or aisle: ";
         cin >> seat;
         if (cin.fail()) {
 
@@ -641,57 +4480,26 @@ if (cin.fail()) {
 
         }
 
-        seatBooked = bookSeat(*flightIt, p.get(), seat);
-    }
-
-    
-    if (isPassengerInBankSystem(p->name)) {
-        double currentBalance = getPassengerBalance(p->name);
-        cout << "\nFlight cost: " << flightIt->price << " ETB";
-        cout << "\nYour current balance: " << currentBalance << " ETB";
-        
-        if (currentBalance >= flightIt->price) {
-            if (processPayment(p->name, flightIt->price)) {
-                cout << "\nPayment processed successfully!";
-                cout << "\nNew balance: " << getPassengerBalance(p->name) << " ETB";
-                
-                Booking b;
-                b.bookingId = "B" + to_string(bookings.size() + 1000);
-                b.flightNo = flightNo;
-                b.passengerId = p->id;
-                b.seatNumber = p->seatNumber;
-                b.bookingTime = getCurrentTime();
-                b.isPaid = true;
-
-                    Passenger* flightPassenger = new Passenger(*p);
-
-                addPassengerToFlight(*flightIt, flightPassenger);
-                passengers.push_back(*p);
-                bookings.push_back(b);
-                userQueue.push(p->id);
-
-                cout << "\nBooking successful! Your Booking ID: " << b.bookingId << "\n";
-            } else {
-                cout << "\nPayment processing failed!\n";
-
-              // Revert seat booking if payment fails
-
-                flightIt->seatMap[p->seatNumber] = false;
-
-                flightIt->totalSeats++; 
-                return;
-            }
+        if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+        price = catalog.price[flight->row];
+        SeatRequest request;
+        if (parseSeatRequest(seat, request)) {
+            string error = claimBestSeat(*flight, *p, request);
+            seatBooked = error.empty();
+            cout << (seatBooked ? "Your seat is " + p->seatNumber + "." : error) << "\n";
         } else {
-            cout << "\nInsufficient funds!\n";
-          // Revert seat booking if insufficient funds
+            seatBooked = bookSeat(*flight, p.get(), seat);
+        }
+        catalogGuard.unlock();
+    }
 
-            flightIt->seatMap[p->seatNumber] = false;
 
-            flightIt->totalSeats++;
-            return;
-        }
+    bool bankCustomer = isPassengerInBankSystem(p->name);
+    if (bankCustomer) {
+        cout << "\nFlight cost: " << price << " ETB";
+        cout << "\nYour current balance: " << getPassengerBalance(p->name) << " ETB";
     } else {
-        cout << "\nTotal to pay: " << flightIt->price << " ETB";
+        cout << "\nTotal to pay: " << price << " ETB";
         cout << "\nConfirm payment? (1=Yes, 0=No): ";
         int confirm;
         cin >> confirm;
@@ -703,54 +4511,165 @@ if (cin.fail()) {
 
             cout << "Invalid input for confirmation!\n";
 
-            // Revert seat booking if input fails
+            if ((flight = lockFlight(catalogGuard, flightNo))) abandonSeat(*flight, *p);
 
-            flightIt->seatMap[p->seatNumber] = false;
+            return;
 
-            flightIt->totalSeats++;
+        }
 
+        if (confirm != 1) {
+            cout << "Booking cancelled.\n";
+            if ((flight = lockFlight(catalogGuard, flightNo))) abandonSeat(*flight, *p);
             return;
+        }
+    }
 
+    // Payment and the booking go through together; a failed payment gives
+    // the held seat back
+    if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+    p->destination = symbolName(catalog.destination[flight->row]);
+    Booking b;
+    try {
+        string error = bookHeldSeat(*flight, *p, b, "");
+        if (!error.empty()) {
+            cout << "\n" << error << "\n";
+            return;
         }
+    } catch (const exception& e) {
+        cout << "\nError saving data: " << e.what();
+    }
 
-        if (confirm == 1) {
-            Booking b;
-            b.bookingId = "B" + to_string(bookings.size() + 1000);
-            b.flightNo = flightNo;
-            b.passengerId = p->id;
-            b.seatNumber = p->seatNumber; 
-            b.bookingTime = getCurrentTime();
-            b.isPaid = true;
+    if (bankCustomer) {
+        cout << "\nPayment processed successfully!";
+        cout << "\nNew balance: " << getPassengerBalance(p->name) << " ETB";
+    }
+    cout << "\nBooking successful! Your Booking ID: " << b.bookingId << "\n";
+}
 
-              Passenger* flightPassenger = new Passenger(*p);
+// Books a whole party on one flight with a single payment. Nobody is booked
+// unless everyone is (see bookHeldGroup).
+void bookGroupFlight() {
+    shared_lock<shared_mutex> catalogGuard(catalogMutex);
+    viewAllFlights();
+    catalogGuard.unlock();
+    string flightNo;
+    cout << "\nEnter flight number: ";
+    cin >> flightNo;
+    if (cin.fail()) {
+        cin.clear();
+        cout << "Flight not found!\n";
+        return;
+    }
+    Flight* flight = lockFlight(catalogGuard, flightNo);
+    if (!flight) return;
+    catalogGuard.unlock();
+
+    int count;
+    cout << "Number of passengers (1-" << MAX_PARTY << "): ";
+    cin >> count;
+    if (cin.fail() || count < 1 || count > MAX_PARTY) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Party size must be 1 to " << MAX_PARTY << "!\n";
+        return;
+    }
+    if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+    if (availableSeats(*flight) < count) {
+        cout << "Not enough seats available!\n";
+        return;
+    }
 
-            addPassengerToFlight(*flightIt, flightPassenger);
-            passengers.push_back(*p);
-            bookings.push_back(b);
-            userQueue.push(p->id);
+    displaySeatMap(*flight);
+    string destination = symbolName(catalog.destination[flight->row]);
+    catalogGuard.unlock();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
 
-            cout << "\nBooking successful! Your Booking ID: " << b.bookingId << "\n";
-        } else {
-             
-            cout << "Booking cancelled.\n";
-               // Revert seat booking if cancelled
+    // Every answer is a whole line; false once input runs out
+    auto ask = [](const string& prompt, string& value, bool (*valid)(const string&)) {
+        do {
+            cout << prompt;
+            if (!getline(cin, value)) return false;
+        } while (!valid(value));
+        return true;
+    };
+
+    string payer;
+    if (!ask("Enter the payer's name (max 20 chars): ", payer, validateInput)) return;
+
+    vector<Passenger> party(count);
+    for (int i = 0; i < count; i++) {
+        Passenger& p = party[i];
+        cout << "\nPassenger " << i + 1 << " of " << count << ":\n";
+        if (!ask("Enter name (max 20 chars): ", p.name, validateInput) ||
+            !ask("Enter passport (max 10 chars): ", p.passport, validatePassport) ||
+            !ask("Enter ID (max 10 digits): ", p.id, validateID) ||
+            !ask("Enter phone (max 15 digits): ", p.contact, validatePhone)) return;
+        p.destination = destination;
+        p.registrationDate = getCurrentTime();
+    }
 
-            flightIt->seatMap[p->seatNumber] = false;
+    if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+    string error = validateGroup(*flight, party);
+    catalogGuard.unlock();
+    if (!error.empty()) {
+        cout << error << "\n";
+        return;
+    }
 
-            flightIt->totalSeats++;
+    string choice;
+    double total = 0;
+    while (true) {
+        cout << "Choose one seat per passenger (e.g., A1,B1,C1), or best, window or aisle: ";
+        if (!getline(cin, choice)) return;
+        if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+        error = claimGroupSeats(*flight, party, choice);
+        total = catalog.price[flight->row] * count;
+        catalogGuard.unlock();
+        if (error.empty()) break;
+        cout << error << "\n";
+    }
+    cout << "Your seats are";
+    for (const Passenger& p : party) cout << " " << p.seatNumber;
+    cout << ".\n";
+
+    bool bankCustomer = isPassengerInBankSystem(payer);
+    if (bankCustomer) {
+        cout << "\nFlight cost: " << total << " ETB";
+        cout << "\nYour current balance: " << getPassengerBalance(payer) << " ETB";
+    } else {
+        cout << "\nTotal to pay: " << total << " ETB";
+        cout << "\nConfirm payment? (1=Yes, 0=No): ";
+        int confirm;
+        cin >> confirm;
+        if (cin.fail() || confirm != 1) {
+            cin.clear();
+            cout << "Booking cancelled.\n";
+            if ((flight = lockFlight(catalogGuard, flightNo))) abandonGroupSeats(*flight, party);
+            return;
         }
     }
-    
 
+    if (!(flight = lockFlight(catalogGuard, flightNo))) return;
+    vector<Booking> group;
     try {
-
-        saveData();
-
+        error = bookHeldGroup(*flight, party, payer, group, "");
+        if (!error.empty()) {
+            cout << "\n" << error << "\n";
+            return;
+        }
     } catch (const exception& e) {
+        cout << "\nError saving data: " << e.what();
+    }
 
-        cout << "Error saving data: " << e.what() << "\n";
-
+    if (bankCustomer) {
+        cout << "\nPayment processed successfully!";
+        cout << "\nNew balance: " << getPassengerBalance(payer) << " ETB";
+    }
+    cout << "\nBooking successful! Your Booking IDs:";
+    for (size_t i = 0; i < group.size(); i++) {
+        cout << "\n" << group[i].bookingId << "  " << party[i].name << "  seat " << group[i].seatNumber;
     }
+    cout << "\n";
 }
 
 void cancelBooking() {
@@ -770,31 +4689,20 @@ void cancelBooking() {
 
     }
 
-    auto booking = find_if(bookings.begin(), bookings.end(), 
-        [&bookingId](const Booking& b) { return b.bookingId == bookingId; });
-
-    if (booking == bookings.end()) {
-        cout << "Booking not found!\n";
-        return;
-    }
-
-    auto flight = find_if(flights.begin(), flights.end(), 
-        [&booking](const Flight& f) { return f.flightNo == booking->flightNo; });
-
-    if (flight != flights.end()) {
-        removePassengerFromFlight(*flight, booking->passengerId);
-    }
-
-    bookings.erase(booking);
-   try {
+    string error;
+    try {
 
-        saveData();
+        error = cancelBookingById(bookingId);
 
     } catch (const exception& e) {
 
         cout << "Error saving data: " << e.what() << "\n";
 
     }
+    if (!error.empty()) {
+        cout << error << "\n";
+        return;
+    }
     cout << "Booking cancelled successfully!\n";
 }
 
@@ -816,31 +4724,28 @@ if (cin.fail()) {
 
 
 
-    bool found = false;
-    for (const auto& b : bookings) {
-        if (b.passengerId == passengerId) {
-            found = true;
-            cout << "\n===== YOUR BOOKING =====";
-            cout << "\nBooking ID: " << b.bookingId;
-            cout << "\nFlight: " << b.flightNo;
-            cout << "\nSeat: " << b.seatNumber;
-            cout << "\nBooking Time: " << timeToString(b.bookingTime);
-            cout << "\nStatus: " << (b.isPaid ? "Paid" : "Unpaid") << "\n";
-            
-            auto passenger = find_if(passengers.begin(), passengers.end(),
-                [&passengerId](const Passenger& p) { return p.id == passengerId; });
-            
-            if (passenger != passengers.end()) {
-                cout << "\nPassenger Details:";
-                cout << "\nName: " << passenger->name;
-                cout << "\nPassport: " << passenger->passport;
-                cout << "\nContact: " << passenger->contact << "\n";
-            }
-            break;
+    shared_lock<shared_mutex> catalogGuard(catalogMutex);
+    lock_guard<mutex> storeGuard(storeMutex);
+    const vector<size_t>& found = bookingsOfPassenger(passengerId);
+    if (!found.empty()) {
+        Booking b = unpackBooking(bookings[found.front()]);
+        cout << "\n===== YOUR BOOKING =====";
+        cout << "\nBooking ID: " << b.bookingId;
+        cout << "\nFlight: " << b.flightNo;
+        cout << "\nSeat: " << b.seatNumber;
+        cout << "\nBooking Time: " << timeToString(b.bookingTime);
+        cout << "\nStatus: " << (b.isPaid ? "Paid" : "Unpaid") << "\n";
+
+        const Flight* flight = findFlight(bookings[found.front()].flightNo);
+        const CompactPassenger* passenger =
+            flight ? findPassenger(passengerId, catalog.destination[flight->row]) : nullptr;
+        if (passenger) {
+            cout << "\nPassenger Details:";
+            cout << "\nName: " << fixedText(passenger->name);
+            cout << "\nPassport: " << fixedText(passenger->passport);
+            cout << "\nContact: " << fixedText(passenger->contact) << "\n";
         }
-    }
-
-    if (!found) {
+    } else {
         cout << "No booking found for this ID!\n";
     }
 }
@@ -879,27 +4784,19 @@ void postponeBooking() {
     }
 
 
-    auto booking = find_if(bookings.begin(), bookings.end(),
-        [&bookingId](const Booking& b) { return b.bookingId == bookingId; });
-
-    if (booking == bookings.end()) {
-        cout << "Booking not found!\n";
-        return;
-    }
-
-   if (booking->passengerId != verifyId) {
-
-        cout << "Invalid passenger ID! Verification failed.\n";
+    Symbol flightSymbol;
+    string error = findOwnedBooking(bookingId, verifyId, flightSymbol);
+    if (!error.empty()) {
+        cout << error << "\n";
         return;
     }
 
-    auto flight = find_if(flights.begin(), flights.end(),
-        [&booking](const Flight& f) { return f.flightNo == booking->flightNo; });
-
-    if (flight != flights.end()) {
-        flight->seatMap[booking->seatNumber] = false;
-        flight->totalSeats++;
+    const string& flightNo = symbolName(flightSymbol);
+    shared_lock<shared_mutex> catalogGuard(catalogMutex, defer_lock);
+    Flight* flight = lockFlight(catalogGuard, flightNo);
+    if (flight) catalogGuard.unlock();
 
+    if (flight) {
         Passenger p;
         cout << "\nEnter new booking details:\n";
              cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -968,7 +4865,19 @@ void postponeBooking() {
             return;
 
         }
+
+        // The stored records only have room for what the validators allow
+        error = validatePassengerDetails(p);
+        if (error.empty() && p.id != verifyId && isPassengerOnFlight(p.id, flightSymbol)) {
+            error = "This ID is already booked on this flight!";
+        }
+        if (!error.empty()) {
+            cout << error << "\n";
+            return;
+        }
+        if (!(flight = lockFlight(catalogGuard, flightNo))) return;
         displaySeatMap(*flight);
+        catalogGuard.unlock();
         
         string newSeat;
         bool seatBooked = false;
@@ -988,80 +4897,27 @@ void postponeBooking() {
 
             }
 
+            if (!(flight = lockFlight(catalogGuard, flightNo))) return;
             seatBooked = bookSeat(*flight, &p, newSeat);
+            catalogGuard.unlock();
 
         }
 
-
-
-        // Update passenger list with new details
-
-        auto passenger = find_if(passengers.begin(), passengers.end(),
-
-            [&booking](const Passenger& p) { return p.id == booking->passengerId; });
-
-        if (passenger != passengers.end()) {
-
-            passenger->name = p.name;
-
-            passenger->passport = p.passport;
-
-            passenger->id = p.id;
-
-            passenger->contact = p.contact;
-
-            passenger->seatNumber = newSeat;
-
-            passenger->registrationDate = getCurrentTime();
-
-        }
-
-
-
-        // Update flight passenger list
-
-        Passenger* current = flight->passengerHead;
-
-        while (current) {
-
-            if (current->id == booking->passengerId) {
-
-                current->name = p.name;
-
-                current->passport = p.passport;
-
-                current->id = p.id;
-
-                current->contact = p.contact;
-
-                current->seatNumber = newSeat;
-
-                current->registrationDate = getCurrentTime();
-
-                break;
-
-            }
-
-            current = current->next;
-
-        }
-
-        booking->passengerId = p.id;
-        booking->seatNumber = newSeat;
-        booking->bookingTime = getCurrentTime();
-
-        cout << "Booking postponed successfully!\n";
+        if (!(flight = lockFlight(catalogGuard, flightNo))) return;
         try {
 
-            saveData();
+            error = postponeToHeldSeat(*flight, bookingId, p);
+            if (!error.empty()) {
+                cout << error << "\n";
+                return;
+            }
 
         } catch (const exception& e) {
 
             cout << "Error saving data: " << e.what() << "\n";
 
         }
-    } else {
-        cout << "Flight not found!\n";
+        cout << "Booking postponed successfully!\n";
     }
 }
 
@@ -1087,9 +4943,10 @@ bool authenticateAdmin() {
 
 void addAircraft() {
     Aircraft a;
+    string model;
     cout << "Enter plane model: ";
      cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    getline(cin, a.model);
+    getline(cin, model);
      if (cin.fail()) {
 
         cin.clear();
@@ -1101,9 +4958,21 @@ void addAircraft() {
         return;
 
     }
+    if (!validateTextField(model)) {
+        cout << "Invalid input for plane model!\n";
+        return;
+    }
+    if (findAircraft(model)) {
+        cout << "Aircraft model already exists!\n";
+        return;
+    }
+    a.model = intern(model);
+    if (int standardSeats = standardSeatCount(model)) {
+        cout << "The standard " << model << " layout has " << standardSeats << " seats.\n";
+    }
     cout << "Enter total seats: ";
     cin >> a.totalSeats;
-      if (cin.fail()) {
+      if (cin.fail() || a.totalSeats < 1 || a.totalSeats > MAX_SEATS) {
 
         cin.clear();
 
@@ -1131,23 +5000,23 @@ void addAircraft() {
         return;
 
     }
+    if (features.find(FEATURE_SEPARATOR) != string::npos) {
+        cout << "Invalid input for features!\n";
+        return;
+    }
     stringstream ss(features);
     string feature;
     while (getline(ss, feature, ',')) {
         a.features.push_back(feature);
     }
     
-    aircrafts.push_back(a);
-    cout << "Aircraft added successfully!\n";
-     try {
-
-        saveData();
-
+    try {
+        commitAddAircraft(a);
     } catch (const exception& e) {
-
         cout << "Error saving data: " << e.what() << "\n";
-
     }
+    cout << "Aircraft added successfully!\n";
+    cout << "Seat layout: " << describeLayout(*layoutFor(a.model, a.totalSeats)) << "\n";
 }
 
 void addFlight() {
@@ -1158,12 +5027,13 @@ void addFlight() {
 
     cout << "\nAvailable Aircrafts:\n";
     for (const auto& a : aircrafts) {
-        cout << "- " << a.model << " (" << a.totalSeats << " seats)\n";
+        cout << "- " << symbolName(a.model) << " (" << a.totalSeats << " seats)\n";
     }
 
-    Flight f;
+    FlightSchedule f;
+    string flightNo;
     cout << "\nEnter flight number: ";
-    cin >> f.flightNo;
+    cin >> flightNo;
      if (cin.fail()) {
 
         cin.clear();
@@ -1175,6 +5045,11 @@ void addFlight() {
         return;
 
     }
+    if (findFlight(flightNo)) {
+        cout << "Flight number already exists!\n";
+        return;
+    }
+    f.flightNo = intern(flightNo);
     cout << "Select plane model: ";
     string selectedModel;
      cin.ignore(numeric_limits<streamsize>::max(), '\n');
@@ -1194,10 +5069,9 @@ void addFlight() {
     }
     
     
-    auto plane = find_if(aircrafts.begin(), aircrafts.end(),
-        [&selectedModel](const Aircraft& a) { return a.model == selectedModel; });
+    const Aircraft* plane = findAircraft(selectedModel);
     
-    if (plane == aircrafts.end()) {
+    if (!plane) {
         cout << "Invalid plane model!\n";
         return;
     }
@@ -1205,10 +5079,9 @@ void addFlight() {
     f.plane = plane->model;
     f.totalSeats = plane->totalSeats;
 
-    initializeSeats(f);
-    
     cout << "Enter destination: ";
-    getline(cin, f.destination);
+    string destination;
+    getline(cin, destination);
      if (cin.fail()) {
 
         cin.clear();
@@ -1220,6 +5093,7 @@ void addFlight() {
         return;
 
     }
+    f.destination = intern(destination);
 
     
 
@@ -1292,14 +5166,17 @@ void addFlight() {
         return;
 
     }
+    if (!validateTextField(flightNo) || !validateTextField(destination) || !validateTextField(f.dayTime) ||
+        !validateTextField(f.distance) || !validateTextField(f.duration)) {
+        cout << "Flight details cannot contain commas!\n";
+        return;
+    }
 
 
 
-    flights.push_back(f);
-
     try {
 
-        saveData();
+        commitAddFlight(f);
 
     } catch (const exception& e) {
 
@@ -1308,7 +5185,7 @@ void addFlight() {
     }
     
     
-    cout << "Flight added successfully using " << plane->model << "!\n";
+    cout << "Flight added successfully using " << symbolName(plane->model) << "!\n";
 }
 
 void displayCurrentState() {
@@ -1318,17 +5195,18 @@ void displayCurrentState() {
         cout << "No aircrafts available.\n";
     } else {
         for (const auto& a : aircrafts) {
-            cout << "- " << a.model << " (" << a.totalSeats << " seats)\n";
+            cout << "- " << symbolName(a.model) << " (" << a.totalSeats << " seats)\n";
         }
     }
 
     cout << "\nFLIGHTS:\n";
-    if (flights.empty()) {
+    if (catalog.size() == 0) {
         cout << "No flights scheduled.\n";
     } else {
-        for (const auto& f : flights) {
-            cout << f.flightNo << " to " << f.destination 
-                 << " (" << f.plane << ") - " << f.totalSeats << " seats available\n";
+        for (size_t row = 0; row < catalog.size(); row++) {
+            cout << symbolName(catalog.flightNo[row]) << " to " << symbolName(catalog.destination[row]) 
+                 << " (" << symbolName(catalog.details[row].plane) << ") - " << availableSeats(row)
+                 << " seats available\n";
         }
     }
 }
@@ -1358,27 +5236,21 @@ void deleteAircraft() {
 
     }
 
-    auto it = find_if(aircrafts.begin(), aircrafts.end(),
-        [&model](const Aircraft& a) { return a.model == model; });
-
-    if (it != aircrafts.end()) {
-        bool inUse = any_of(flights.begin(), flights.end(),
-            [&model](const Flight& f) { return f.plane == model; });
+    const Aircraft* aircraft = findAircraft(model);
+    if (aircraft) {
+        Symbol symbol = aircraft->model;
+        bool inUse = any_of(catalog.details.begin(), catalog.details.end(),
+            [symbol](const Flight& f) { return f.plane == symbol; });
 
         if (inUse) {
             cout << "Cannot delete! Aircraft is in use by flights.\n";
         } else {
-            aircrafts.erase(it);
-            cout << "Aircraft deleted successfully!\n";
-               try {
-
-                saveData();
-
+            try {
+                commitDeleteAircraft(model);
             } catch (const exception& e) {
-
                 cout << "Error saving data: " << e.what() << "\n";
-
             }
+            cout << "Aircraft deleted successfully!\n";
         }
     } else {
         cout << "Aircraft not found!\n";
@@ -1387,7 +5259,7 @@ void deleteAircraft() {
 
 void deleteFlight() {
     displayCurrentState();
-    if (flights.empty()) {
+    if (catalog.size() == 0) {
         cout << "No flights to delete.\n";
         return;
     }
@@ -1407,44 +5279,18 @@ void deleteFlight() {
 
     }
 
-    auto it = find_if(flights.begin(), flights.end(), 
-        [&flightNo](const Flight& f) { return f.flightNo == flightNo; });
-
-    if (it != flights.end()) {
-        // Free passenger me
-        Passenger* current = it->passengerHead;
-        while (current) {
-            Passenger* temp = current;
-            current = current->next;
-            delete temp;
-        }
-         it->passengerHead = nullptr;
-
-        
-
-        bookings.erase(
-
-            remove_if(bookings.begin(), bookings.end(),
-
-                [&flightNo](const Booking& b) { return b.flightNo == flightNo; }),
-
-            bookings.end());
-
-        
-
-        flights.erase(it);
-
-        cout << "Flight deleted successfully!\n";
-
+    if (findFlight(flightNo)) {
         try {
 
-            saveData();
+            commitDeleteFlight(flightNo);
 
         } catch (const exception& e) {
 
             cout << "Error saving data: " << e.what() << "\n";
 
         }
+
+        cout << "Flight deleted successfully!\n";
         
         
     } else {
@@ -1464,14 +5310,14 @@ void displayPassengerWithDestination() {
          << "Registration Date\n";
     
     for (const auto& p : passengers) {
-        cout << setw(20) << p.name << setw(15) << p.destination
-             << setw(12) << p.passport << setw(12) << p.id
+        cout << setw(20) << fixedText(p.name) << setw(15) << symbolName(p.destination)
+             << setw(12) << fixedText(p.passport) << setw(12) << fixedText(p.id)
              << timeToString(p.registrationDate) << "\n";
     }
 }
 
 void displayBookingsWithEmptyCheck() {
-    if (bookings.empty()) {
+    if (liveBookingCount() == 0) {
         cout << "\nNo bookings found in the system.\n";
         return;
     }
@@ -1481,7 +5327,9 @@ void displayBookingsWithEmptyCheck() {
          << setw(12) << "Passenger ID" << setw(10) << "Seat" 
          << setw(20) << "Booking Time" << "Status\n";
     
-    for (const auto& b : bookings) {
+    for (const auto& stored : bookings) {
+        if (!stored.number) continue;
+        Booking b = unpackBooking(stored);
         cout << setw(10) << b.bookingId << setw(10) << b.flightNo 
              << setw(12) << b.passengerId << setw(10) << b.seatNumber
              << setw(20) << timeToString(b.bookingTime) 
@@ -1491,7 +5339,7 @@ void displayBookingsWithEmptyCheck() {
 
 void adminCancelBooking() {
     displayBookingsWithEmptyCheck();
-    if (bookings.empty()) return;
+    if (liveBookingCount() == 0) return;
 
     string bookingId;
     cout << "Enter booking ID to cancel: ";
@@ -1507,31 +5355,20 @@ void adminCancelBooking() {
         return;
 
     }
-    auto booking = find_if(bookings.begin(), bookings.end(), 
-        [&bookingId](const Booking& b) { return b.bookingId == bookingId; });
-
-    if (booking == bookings.end()) {
-        cout << "Booking not found!\n";
-        return;
-    }
-
-    auto flight = find_if(flights.begin(), flights.end(), 
-        [&booking](const Flight& f) { return f.flightNo == booking->flightNo; });
-
-    if (flight != flights.end()) {
-        removePassengerFromFlight(*flight, booking->passengerId);
-    }
-
-    bookings.erase(booking);
-      try {
+    string error;
+    try {
 
-        saveData();
+        error = cancelBookingById(bookingId);
 
     } catch (const exception& e) {
 
         cout << "Error saving data: " << e.what() << "\n";
 
     }
+    if (!error.empty()) {
+        cout << error << "\n";
+        return;
+    }
     cout << "Admin: Booking cancelled successfully!\n";
 
 }
@@ -1540,9 +5377,33 @@ void displayBankStatement() {
     cout << "\n===== BANK STATEMENT =====";
     cout << "\n" << left << setw(25) << "Name" << "Balance (ETB)\n";
     cout << "--------------------------------\n";
-    for (const auto& account : bankRecords) {
-        cout << setw(25) << account.name << account.balance << "\n";
+    {
+        lock_guard<mutex> guard(bankMutex);
+        for (const auto& account : bankRecords) {
+            cout << setw(25) << account.name << account.balance << "\n";
+        }
+    }
+
+    string name;
+    cout << "\nEnter a name to see its transactions (0 to return): ";
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    getline(cin, name);
+    if (cin.fail()) {
+
+        cin.clear();
+
+        cout << "Invalid input for name!\n";
+
+        return;
+
+    }
+    if (name == "0") return;
+
+    if (!isPassengerInBankSystem(name)) {
+        cout << "Account not found!\n";
+        return;
     }
+    streamAccountHistory(name, cout);
 }
 
 
@@ -1553,6 +5414,7 @@ void adminMenu() {
         cout << "Access denied!\n";
         return;
     }
+    refreshState();
 
     int choice;
     do {
@@ -1565,7 +5427,8 @@ void adminMenu() {
         cout << "\n6. View All Passengers";
         cout << "\n7. View All Bookings";
         cout << "\n8. Cancel Any Booking";
-        cout << "\n9. Return to Main Menu";
+        cout << "\n9. Reload Data From Disk";
+        cout << "\n10. Return to Main Menu";
         cout << "\nEnter choice: ";
         cin >> choice;
  if (cin.fail()) {
@@ -1588,14 +5451,17 @@ void adminMenu() {
             case 6: displayPassengerWithDestination(); break;
             case 7: displayBookingsWithEmptyCheck(); break;
             case 8: adminCancelBooking(); break;
-            case 9: break;
+            case 9:
+                if (reloadData()) cout << "Data reloaded successfully!\n";
+                break;
+            case 10: break;
             default: cout << "Invalid choice!\n";
         }
-    } while (choice != 9);
+    } while (choice != 10);
 }
 
 void passengerMenu() {
-    loadData();
+    refreshState();
     int choice;
     do {
         cout << "\n===== PASSENGER MENU =====";
@@ -1605,7 +5471,8 @@ void passengerMenu() {
         cout << "\n4. View Current Booking";
         cout << "\n5. Postpone Booking";
         cout << "\n6. Cancel Booking";
-        cout << "\n7. Back to Main Menu";
+        cout << "\n7. Book for a Group";
+        cout << "\n8. Back to Main Menu";
         cout << "\nEnter choice: ";
         cin >> choice;
     if (cin.fail()) {
@@ -1626,30 +5493,849 @@ void passengerMenu() {
             case 4: viewCurrentBooking(); break;
             case 5: postponeBooking(); break;
             case 6: cancelBooking(); break;
-            case 7: break;
+            case 7: bookGroupFlight(); break;
+            case 8: break;
             default: cout << "Invalid choice!\n";
         }
-    } while (choice != 7);
+    } while (choice != 8);
 }
 
 
 
-// ===================== MAIN FUNCTION =====================
-int main() {
-    if (flights.empty()) {
-        flights = {
-            {"AF101", "Cairo", "Mon 08:00 AM", "1200 km", "Boeing 737", "2h", 100, 2500.00f, nullptr, {}},
-               {"AF202", "Nairobi", "Tue 10:30 AM", "1800 km", "Airbus A320", "3h", 100, 3000.00f, nullptr, {}}
+// ===================== BATCH MODE =====================
+// --batch <file|-> runs newline-delimited commands without any prompts.
+// Fields are separated by '|'; blank lines and lines starting with '#'
+// are skipped:
+//   book|<flight>|<seat or preferences>|<name>|<passport>|<id>|<phone>[|<payment key>]
+//   allocate|<flight>|<party size>[|<preferences>]
+//   group|<flight>|<seats or preferences>|<payer>|<payment key or empty>
+//        |<name>|<passport>|<id>|<phone>[|<name>|...]
+//   cancel|<bookingId>
+//   postpone|<bookingId>|<passengerId>|<name>|<passport>|<id>|<phone>|<seat>
+//   add-aircraft|<model>|<seats>|<features, separated by commas>
+//   add-flight|<flight>|<aircraft>|<destination>|<day/time>|<distance>|<duration>|<price>
+//   query|<flight or bookingId>
+//   search|<text in the destination>
+//   suggest|<start of a destination word>
+// Each command prints one line, "<line>|ok|<command>|<fields...>" or
+// "<line>|error|<command>|<message>". Preferences are parseSeatRequest's
+// ("window", "aisle+business", ...); book claims the best such seat and
+// allocate only lists the seats a party would get. group books every
+// passenger it lists, four fields each, with one payment by the payer, or
+// none of them; its seats are preferences for the whole party or one seat
+// per passenger separated by commas (A1,B1,C1). Results are printed in groups of
+// BATCH_GROUP_SIZE commands, after the group's journal records are synced
+// with a single fdatasync, so an "ok" line is always durable; if the sync
+// fails, every command of the group is reported as an error. A book or
+// group command retried with the payment key of a payment that went
+// through returns the original bookings instead of charging again. Keys are
+// recorded with the payment, so only bank account holders can give one, and
+// may not contain commas or spaces.
+const size_t BATCH_GROUP_SIZE = 1024;
+
+vector<string> splitCommand(const string& line) {
+    vector<string> args;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('|', start);
+        args.push_back(line.substr(start, end - start));
+        if (end == string::npos) break;
+        start = end + 1;
+    }
+    if (!args.empty() && !args.back().empty() && args.back().back() == '\r') args.back().pop_back();
+    return args;
+}
+
+// Returns "ok|..." or "error|<message>" for one command
+string runBatchCommand(const vector<string>& args) {
+    const string& command = args[0];
+
+    // Every command but add-flight uses flights it looked up; add-flight
+    // takes the catalog exclusively itself (see commitAddFlight)
+    shared_lock<shared_mutex> catalogGuard(catalogMutex, defer_lock);
+    if (command != "add-flight") catalogGuard.lock();
+
+    if (command == "book" && (args.size() == 7 || args.size() == 8)) {
+        string paymentKey = args.size() == 8 ? args[7] : "";
+        if (!validatePaymentKey(paymentKey)) return "error|Invalid payment key!";
+        string previous = paymentKey.empty() ? "" : paymentReference(paymentKey);
+        if (!previous.empty()) {
+            lock_guard<mutex> guard(storeMutex);
+            int index = findBookingIndex(previous);
+            if (index < 0) return "error|Payment was already made for booking " + previous + "!";
+            Booking b = unpackBooking(bookings[index]);
+            return "ok|" + b.bookingId + "|" + b.flightNo + "|" + b.seatNumber;
+        }
+
+        Flight* flight = findFlight(args[1]);
+        if (!flight) return "error|Flight not found!";
+        if (availableSeats(*flight) <= 0) return "error|No seats available!";
+
+        Passenger p;
+        p.name = args[3];
+        p.passport = args[4];
+        p.id = args[5];
+        p.contact = args[6];
+        string error = validatePassengerDetails(p);
+        if (!error.empty()) return "error|" + error;
+        if (isPassengerOnFlight(p.id, flight->flightNo)) return "error|This ID is already booked on this flight!";
+
+        p.destination = symbolName(catalog.destination[flight->row]);
+        p.registrationDate = getCurrentTime();
+
+        SeatRequest request;
+        error = parseSeatRequest(args[2], request) ? claimBestSeat(*flight, p, request) : claimSeat(*flight, p, args[2]);
+        if (!error.empty()) return "error|" + error;
+
+        Booking b;
+        error = bookHeldSeat(*flight, p, b, paymentKey);
+        if (!error.empty()) return "error|" + error;
+        return "ok|" + b.bookingId + "|" + b.flightNo + "|" + b.seatNumber;
+    }
+
+    if (command == "group" && args.size() >= 9 && (args.size() - 5) % 4 == 0) {
+        const string& paymentKey = args[4];
+        if (!validatePaymentKey(paymentKey)) return "error|Invalid payment key!";
+        string previous = paymentKey.empty() ? "" : paymentReference(paymentKey);
+        if (!previous.empty()) {
+            lock_guard<mutex> guard(storeMutex);
+            stringstream ss(previous);
+            string bookingId, result;
+            size_t count = 0;
+            while (ss >> bookingId) {
+                int index = findBookingIndex(bookingId);
+                if (index < 0) return "error|Payment was already made for booking " + previous + "!";
+                result += "|" + bookingId + "|" + seatCodeToString(bookings[index].seat);
+                count++;
+            }
+            return "ok|" + to_string(count) + result;
+        }
+
+        Flight* flight = findFlight(args[1]);
+        if (!flight) return "error|Flight not found!";
+        if (!validateInput(args[3])) return "error|Invalid input for payer name!";
+
+        vector<Passenger> party((args.size() - 5) / 4);
+        time_t now = getCurrentTime();
+        for (size_t i = 0; i < party.size(); i++) {
+            Passenger& p = party[i];
+            p.name = args[5 + 4 * i];
+            p.passport = args[6 + 4 * i];
+            p.id = args[7 + 4 * i];
+            p.contact = args[8 + 4 * i];
+            p.destination = symbolName(catalog.destination[flight->row]);
+            p.registrationDate = now;
+        }
+        string error = validateGroup(*flight, party);
+        if (error.empty()) error = claimGroupSeats(*flight, party, args[2]);
+        if (!error.empty()) return "error|" + error;
+
+        vector<Booking> group;
+        error = bookHeldGroup(*flight, party, args[3], group, paymentKey);
+        if (!error.empty()) return "error|" + error;
+        string result = "ok|" + to_string(group.size());
+        for (const Booking& b : group) result += "|" + b.bookingId + "|" + b.seatNumber;
+        return result;
+    }
+
+    if (command == "cancel" && args.size() == 2) {
+        string error = cancelBookingById(args[1]);
+        if (!error.empty()) return "error|" + error;
+        return "ok|" + args[1];
+    }
+
+    if (command == "postpone" && args.size() == 8) {
+        Symbol flightNo;
+        string error = findOwnedBooking(args[1], args[2], flightNo);
+        if (!error.empty()) return "error|" + error;
+
+        Flight* flight = findFlight(flightNo);
+        if (!flight) return "error|Flight not found!";
+
+        Passenger p;
+        p.name = args[3];
+        p.passport = args[4];
+        p.id = args[5];
+        p.contact = args[6];
+        error = validatePassengerDetails(p);
+        if (error.empty() && p.id != args[2] && isPassengerOnFlight(p.id, flight->flightNo)) {
+            error = "This ID is already booked on this flight!";
+        }
+        if (error.empty()) error = claimSeat(*flight, p, args[7]);
+        if (!error.empty()) return "error|" + error;
+
+        error = postponeToHeldSeat(*flight, args[1], p);
+        if (!error.empty()) return "error|" + error;
+        return "ok|" + args[1] + "|" + p.seatNumber;
+    }
+
+    if (command == "add-aircraft" && args.size() == 4) {
+        if (args[1].empty() || !validateTextField(args[1])) return "error|Invalid input for plane model!";
+        if (findAircraft(args[1])) return "error|Aircraft model already exists!";
+
+        Aircraft a;
+        if (!parseNumber(string_view(args[2]), a.totalSeats) || a.totalSeats < 1 || a.totalSeats > MAX_SEATS) {
+            return "error|Invalid input for total seats!";
+        }
+        if (args[3].find(FEATURE_SEPARATOR) != string::npos) return "error|Invalid input for features!";
+        a.model = intern(args[1]);
+        stringstream ss(args[3]);
+        string feature;
+        while (getline(ss, feature, ',')) a.features.push_back(feature);
+
+        commitAddAircraft(a);
+        return "ok|" + args[1] + "|" + to_string(a.totalSeats);
+    }
+
+    if (command == "add-flight" && args.size() == 8) {
+        if (findFlight(args[1])) return "error|Flight number already exists!";
+        const Aircraft* plane = findAircraft(args[2]);
+        if (!plane) return "error|Invalid plane model!";
+
+        FlightSchedule f;
+        if (!parseNumber(string_view(args[7]), f.price)) return "error|Invalid input for price!";
+        for (size_t field : {1, 3, 4, 5, 6}) {
+            if (!validateTextField(args[field])) return "error|Flight details cannot contain commas!";
+        }
+        f.flightNo = intern(args[1]);
+        f.plane = plane->model;
+        f.totalSeats = plane->totalSeats;
+        f.destination = intern(args[3]);
+        f.dayTime = args[4];
+        f.distance = args[5];
+        f.duration = args[6];
+
+        commitAddFlight(f);
+        return "ok|" + args[1] + "|" + to_string(f.totalSeats);
+    }
+
+    if (command == "allocate" && (args.size() == 3 || args.size() == 4)) {
+        Flight* flight = findFlight(args[1]);
+        if (!flight) return "error|Flight not found!";
+        SeatRequest request;
+        if (!parseNumber(string_view(args[2]), request.party) || request.party < 1 || request.party > MAX_PARTY) {
+            return "error|Party size must be 1 to " + to_string(MAX_PARTY) + "!";
+        }
+        if (args.size() == 4 && !parseSeatRequest(args[3], request)) return "error|Unknown seat preference!";
+
+        vector<SeatIndex> found = allocateSeats(*flight->layout, flight->seats, request);
+        if (found.empty()) return "error|Not enough seats available!";
+        string result = "ok|" + to_string(found.size());
+        for (SeatIndex seat : found) result += "|" + seatCodeToString(flight->layout->codes[seat]);
+        return result;
+    }
+
+    if (command == "search" && args.size() == 2) {
+        vector<size_t> rows = searchDestinations(args[1]);
+        string result = "ok|" + to_string(rows.size());
+        for (size_t row : rows) result += "|" + symbolName(catalog.flightNo[row]);
+        return result;
+    }
+
+    if (command == "suggest" && args.size() == 2) {
+        vector<Symbol> found = suggestDestinations(args[1]);
+        string result = "ok|" + to_string(found.size());
+        for (Symbol destination : found) result += "|" + symbolName(destination);
+        return result;
+    }
+
+    if (command == "query" && args.size() == 2) {
+        if (const Flight* f = findFlight(args[1])) {
+            ostringstream out;
+            out << "ok|flight|" << symbolName(f->flightNo) << "|" << symbolName(catalog.destination[f->row]) << "|"
+                << f->dayTime << "|" << symbolName(f->plane) << "|" << availableSeats(*f) << "|"
+                << catalog.price[f->row];
+            return out.str();
+        }
+        Booking b;
+        {
+            lock_guard<mutex> guard(storeMutex);
+            int bookingPos = findBookingIndex(args[1]);
+            if (bookingPos < 0) return "error|No flight or booking " + args[1];
+            b = unpackBooking(bookings[bookingPos]);
+        }
+        return "ok|booking|" + b.bookingId + "|" + b.flightNo + "|" + b.passengerId + "|" +
+               b.seatNumber + "|" + timeToString(b.bookingTime) + "|" + (b.isPaid ? "paid" : "pending");
+    }
+
+    return "error|Unknown command or wrong number of fields";
+}
+
+int runBatch(const string& path) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file.is_open()) {
+            cerr << "Cannot open batch file " << path << "\n";
+            return 1;
+        }
+    }
+    istream& in = path == "-" ? cin : file;
+
+    string line;
+    size_t lineNo = 0, succeeded = 0, failed = 0;
+    // Line number, command and result of each command in the current group
+    vector<tuple<size_t, string, string>> group;
+
+    // Prints the results of the current group once its records are on disk.
+    // If they cannot be written, none of its commands is reported as done.
+    auto flushResults = [&group, &succeeded, &failed]() {
+        string failure;
+        try {
+            syncDeferredJournal();
+        } catch (const exception& e) {
+            failure = string("error|Error saving data: ") + e.what();
+            cerr << "Error saving data: " << e.what() << "\n";
+        }
+        for (auto& [number, command, result] : group) {
+            if (!failure.empty() && result.compare(0, 3, "ok|") == 0) result = failure;
+            bool ok = result.compare(0, 3, "ok|") == 0;
+            (ok ? succeeded : failed)++;
+            result.insert(ok ? 3 : 6, command + "|");
+            cout << number << "|" << result << "\n";
+        }
+        group.clear();
+        return failure.empty();
+    };
+
+    deferJournalSync = true;
+    bool synced = true;
+    while (synced && getline(in, line)) {
+        lineNo++;
+        if (line.empty() || line[0] == '#' || line == "\r") continue;
+
+        vector<string> args = splitCommand(line);
+        string result;
+        try {
+            result = runBatchCommand(args);
+        } catch (const exception& e) {
+            result = string("error|Error saving data: ") + e.what();
+        }
+        group.emplace_back(lineNo, args[0], result);
+
+        if (group.size() == BATCH_GROUP_SIZE) synced = flushResults();
+    }
+    if (synced) synced = flushResults();
+    deferJournalSync = false;
+    cout << flush;
+    if (!synced) return 1;
+
+    cerr << "Batch finished: " << succeeded << " ok, " << failed << " failed\n";
+    return 0;
+}
+
+// ===================== BENCHMARK =====================
+// --benchmark <threads> measures booking throughput for 1, 2, 4, ... up to
+// <threads> workers. Every worker books every seat of its own
+// BENCH_FLIGHTS_PER_WORKER flights through claimSeat/completeBooking, the
+// same path the menus and batch mode use, with journaling on. It runs in a
+// scratch directory so the real data files are never touched.
+const size_t BENCH_FLIGHTS_PER_WORKER = 200;
+const int BENCH_SEATS = 100; // per flight
+
+void resetBenchmarkState(size_t flightCount) {
+    clearCatalog(flightCount);
+    clearBookings();
+    clearPassengerRecords();
+
+    for (size_t i = 0; i < flightCount; i++) {
+        FlightSchedule f;
+        f.flightNo = intern("BF" + to_string(i));
+        f.destination = intern("Bench");
+        f.dayTime = "Mon 08:00 AM";
+        f.distance = "1000 km";
+        f.plane = intern("Boeing 737");
+        f.duration = "2h";
+        f.totalSeats = BENCH_SEATS;
+        f.price = 100.0f;
+        applyAddFlight(f);
+    }
+
+    remove(JOURNAL_FILE);
+    openJournal();
+}
+
+void bookAllSeats(size_t firstFlight, size_t flightCount, size_t worker) {
+    shared_lock<shared_mutex> catalogGuard(catalogMutex);
+    for (size_t i = firstFlight; i < firstFlight + flightCount; i++) {
+        Flight& flight = catalog.details[i];
+        for (SeatIndex seat = 0; seat < flight.totalSeats; seat++) {
+            SeatCode code = flight.layout->codes[seat];
+            Passenger p;
+            p.name = "Bench " + to_string(worker);
+            p.passport = "P" + to_string(worker);
+            p.id = to_string(i * BENCH_SEATS + seat);
+            p.contact = "0900";
+            p.destination = symbolName(catalog.destination[i]);
+            p.registrationDate = getCurrentTime();
+
+            if (!claimSeat(flight, p, seatCodeToString(code)).empty()) continue;
+            Booking b;
+            bookHeldSeat(flight, p, b, "");
+        }
+    }
+}
+
+int runBenchmark(int maxThreads) {
+    char scratch[] = "/tmp/airline-bench-XXXXXX";
+    if (!mkdtemp(scratch) || chdir(scratch) != 0) {
+        cerr << "Cannot create a scratch directory for the benchmark\n";
+        return 1;
+    }
+
+    vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    cout << "Booking throughput (" << BENCH_FLIGHTS_PER_WORKER << " flights x "
+         << BENCH_SEATS << " seats per worker, " << thread::hardware_concurrency()
+         << " hardware threads)\n";
+    cout << left << setw(10) << "Threads" << setw(12) << "Bookings"
+         << setw(12) << "Seconds" << setw(14) << "Bookings/s" << "Speedup\n";
+
+    double baseline = 0;
+    int status = 0;
+    for (int threads : threadCounts) {
+        try {
+            resetBenchmarkState(BENCH_FLIGHTS_PER_WORKER * threads);
+        } catch (const exception& e) {
+            cerr << "Error opening journal: " << e.what() << "\n";
+            status = 1;
+            break;
+        }
+
+        auto start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (int w = 0; w < threads; w++) {
+            workers.emplace_back(bookAllSeats, w * BENCH_FLIGHTS_PER_WORKER, BENCH_FLIGHTS_PER_WORKER, w);
+        }
+        for (auto& worker : workers) worker.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        double rate = liveBookingCount() / seconds;
+        if (baseline == 0) baseline = rate;
+        cout << setw(10) << threads << setw(12) << liveBookingCount() << setw(12) << fixed
+             << setprecision(3) << seconds << setw(14) << setprecision(0) << rate
+             << setprecision(2) << rate / baseline << "x\n";
+    }
+
+    clearCatalog();
+    if (journal.fd >= 0) close(journal.fd);
+    remove(JOURNAL_FILE);
+    if (chdir("/") == 0) rmdir(scratch);
+    return status;
+}
+
+// --seat-stress <threads> has 1, 2, 4, ... up to <threads> threads fight over
+// the seats of one flight. Each thread claims random seats through claimSeat,
+// holds up to SEAT_STRESS_HELD of them and gives the oldest back through
+// abandonSeat. Every win is recorded in a shared owner table, where a seat
+// held by two threads at once shows up as a double booking.
+const size_t SEAT_STRESS_ATTEMPTS = 200000; // per thread
+const size_t SEAT_STRESS_HELD = 4;
+const int SEAT_STRESS_SEATS = 100;
+
+void stressSeats(Flight& flight, atomic<int>* owners, int worker, SeatStressResult& result) {
+    shared_lock<shared_mutex> catalogGuard(catalogMutex);
+    vector<string> seatNames;
+    for (SeatCode code : flight.layout->codes) seatNames.push_back(seatCodeToString(code));
+
+    mt19937 random(worker + 1);
+    Passenger p;
+    p.id = to_string(worker);
+    vector<SeatIndex> held;
+
+    auto releaseOldest = [&]() {
+        SeatIndex seat = held.front();
+        held.erase(held.begin());
+        owners[seat].store(0);
+        p.seatNumber = seatNames[seat];
+        abandonSeat(flight, p);
+    };
+
+    for (size_t i = 0; i < SEAT_STRESS_ATTEMPTS; i++) {
+        SeatIndex seat = static_cast<SeatIndex>(random() % seatNames.size());
+        if (!claimSeat(flight, p, seatNames[seat]).empty()) continue;
+
+        result.claims++;
+        if (owners[seat].exchange(worker + 1) != 0) result.doubleBooked++;
+        held.push_back(seat);
+        if (held.size() > SEAT_STRESS_HELD) releaseOldest();
+    }
+    while (!held.empty()) releaseOldest();
+}
+
+int runSeatStress(int maxThreads) {
+    vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    cout << "Seat claim contention (1 flight x " << SEAT_STRESS_SEATS << " seats, "
+         << SEAT_STRESS_ATTEMPTS << " claims per thread, " << thread::hardware_concurrency()
+         << " hardware threads)\n";
+    cout << left << setw(10) << "Threads" << setw(12) << "Attempts" << setw(12) << "Won"
+         << setw(12) << "Seconds" << setw(14) << "Attempts/s" << "Double booked\n";
+
+    int status = 0;
+    for (int threads : threadCounts) {
+        clearCatalog(1);
+        addFlightToCatalog({intern("STRESS"), 0, "", "", 0, "", SEAT_STRESS_SEATS, 0.0f});
+        Flight& flight = catalog.details[0];
+
+        atomic<int> owners[SEAT_STRESS_SEATS];
+        for (auto& owner : owners) owner.store(0);
+        vector<SeatStressResult> results(threads);
+
+        auto start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (int w = 0; w < threads; w++) {
+            workers.emplace_back(stressSeats, ref(flight), owners, w, ref(results[w]));
+        }
+        for (auto& worker : workers) worker.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        SeatStressResult total;
+        for (const auto& result : results) {
+            total.claims += result.claims;
+            total.doubleBooked += result.doubleBooked;
+        }
+        size_t attempts = SEAT_STRESS_ATTEMPTS * threads;
+        cout << setw(10) << threads << setw(12) << attempts << setw(12) << total.claims
+             << setw(12) << fixed << setprecision(3) << seconds << setw(14) << setprecision(0)
+             << attempts / seconds << total.doubleBooked << "\n";
+
+        if (total.doubleBooked > 0 || occupiedSeatCount(flight.seats) != 0 ||
+            availableSeats(flight) != flight.totalSeats) {
+            cerr << "Seat inventory is inconsistent after " << threads << " threads!\n";
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// --layout-benchmark times the seat functions claimSeat and the seat map
+// depend on, for each aircraft with a FleetLayout: once instantiated for
+// its compile-time tables and once for the runtime SeatLayout compiled from
+// the same definition. A pass parses every name on the grid (including
+// positions without a seat), claims the seats that exist and releases them.
+const int LAYOUT_BENCH_PASSES = 20000;
+const int LAYOUT_BENCH_MAPS = 2000;
+
+template <typename Layout>
+size_t claimEverySeat(const Layout& layout, const vector<string>& names, SeatInventory& seats) {
+    size_t claimed = 0;
+    SeatCode code;
+    for (const auto& name : names) {
+        SeatIndex seat = parseLayoutSeat(layout, name, code);
+        if (seat != NO_SEAT && tryClaimSeat(seats, seat)) claimed++;
+    }
+    for (const auto& name : names) {
+        SeatIndex seat = parseLayoutSeat(layout, name, code);
+        if (seat != NO_SEAT) releaseSeat(seats, layoutSeatIndex(layout, code));
+    }
+    return claimed;
+}
+
+// Nanoseconds per seat name, and the seats claimed in total
+template <typename Layout>
+double timeSeatClaims(const Layout& layout, const vector<string>& names, size_t& claimed) {
+    SeatInventory seats;
+    claimed = 0;
+    auto start = chrono::steady_clock::now();
+    for (int pass = 0; pass < LAYOUT_BENCH_PASSES; pass++) claimed += claimEverySeat(layout, names, seats);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (double(LAYOUT_BENCH_PASSES) * names.size());
+}
+
+// Microseconds per seat map of a half-booked flight, and the map itself
+template <typename Layout>
+double timeSeatMaps(const Layout& layout, const SeatInventory& seats, string& map) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < LAYOUT_BENCH_MAPS; i++) {
+        ostringstream out;
+        renderSeatMap(layout, seats, out);
+        map = out.str();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return seconds * 1e6 / LAYOUT_BENCH_MAPS;
+}
+
+int runLayoutBenchmark() {
+    cout << "Seat layout paths (" << LAYOUT_BENCH_PASSES << " passes over every seat name, "
+         << LAYOUT_BENCH_MAPS << " seat maps)\n";
+    cout << left << setw(14) << "Aircraft" << setw(22) << "Operation" << setw(12) << "Generic"
+         << setw(14) << "Specialized" << "Speedup\n";
+
+    int status = 0;
+    auto compare = [&status](const string& model, const auto& tables) {
+        const SeatLayout& layout = *layoutFor(intern(model), tables.capacity);
+        if (layout.fleet == FleetModel::None) {
+            cerr << "No compile-time layout in use for " << model << "!\n";
+            status = 1;
+            return;
+        }
+
+        vector<string> names;
+        for (int row = 1; row <= layout.rows; row++) {
+            for (char letter : layout.letters) names.push_back(letter + to_string(row));
+        }
+        size_t genericClaims, fleetClaims;
+        double generic = timeSeatClaims(layout, names, genericClaims);
+        double specialized = timeSeatClaims(tables, names, fleetClaims);
+        cout << setw(14) << model << setw(22) << "claim + release (ns)" << fixed << setprecision(1)
+             << setw(12) << generic << setw(14) << specialized << setprecision(2)
+             << generic / specialized << "x\n";
+
+        SeatInventory seats;
+        for (SeatIndex seat = 0; seat < layout.capacity(); seat += 2) tryClaimSeat(seats, seat);
+        string genericMap, fleetMap;
+        generic = timeSeatMaps(layout, seats, genericMap);
+        specialized = timeSeatMaps(tables, seats, fleetMap);
+        cout << setw(14) << model << setw(22) << "seat map (us)" << setprecision(1) << setw(12)
+             << generic << setw(14) << specialized << setprecision(2) << generic / specialized << "x\n";
+
+        size_t expected = size_t(LAYOUT_BENCH_PASSES) * layout.capacity();
+        if (genericClaims != expected || fleetClaims != expected || genericMap != fleetMap) {
+            cerr << "Generic and specialized paths disagree for " << model << "!\n";
+            status = 1;
+        }
+    };
+    compare(FleetDefinition<FleetModel::Boeing737>::model, fleetLayout<FleetModel::Boeing737>);
+    compare(FleetDefinition<FleetModel::AirbusA320>::model, fleetLayout<FleetModel::AirbusA320>);
+    return status;
+}
+
+// --allocation-benchmark times allocateSeats on every standard layout, from
+// an empty cabin to a full one, where every row is searched and nothing is
+// found. Seats are booked at random, the same ones on every run.
+const int ALLOCATION_BENCH_SEARCHES = 200000;
+
+int runAllocationBenchmark() {
+    struct Case {
+        const char* label;
+        SeatRequest request;
+    };
+    vector<Case> cases(3);
+    cases[0].label = "1, window";
+    cases[0].request.window = true;
+    cases[1].label = "3 together, aisle";
+    cases[1].request.party = 3;
+    cases[1].request.aisle = true;
+    cases[2].label = "4 apart";
+    cases[2].request.party = 4;
+    cases[2].request.together = false;
+
+    cout << "Seat allocation (" << ALLOCATION_BENCH_SEARCHES << " searches per line)\n";
+    cout << left << setw(14) << "Aircraft" << setw(10) << "Booked" << setw(20) << "Party"
+         << setw(14) << "ns/search" << "Seats found\n";
+
+    for (const auto& definition : STANDARD_LAYOUTS) {
+        const SeatLayout& layout = *layoutFor(intern(definition.model), standardSeatCount(definition.model));
+        for (int percent : {0, 90, 100}) {
+            SeatInventory seats;
+            mt19937 random(percent);
+            for (SeatIndex seat = 0; seat < layout.capacity(); seat++) {
+                if (static_cast<int>(random() % 100) < percent) tryClaimSeat(seats, seat);
+            }
+
+            for (const auto& test : cases) {
+                size_t found = 0;
+                auto start = chrono::steady_clock::now();
+                for (int i = 0; i < ALLOCATION_BENCH_SEARCHES; i++) {
+                    found += allocateSeats(layout, seats, test.request).size();
+                }
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+                vector<SeatIndex> seatsFound = allocateSeats(layout, seats, test.request);
+                string names;
+                for (SeatIndex seat : seatsFound) names += (names.empty() ? "" : " ") + seatCodeToString(layout.codes[seat]);
+                cout << setw(14) << definition.model << setw(10) << to_string(occupiedSeatCount(seats)) + "/" +
+                        to_string(layout.capacity()) << setw(20) << test.label << setw(14) << fixed
+                     << setprecision(1) << seconds * 1e9 / ALLOCATION_BENCH_SEARCHES
+                     << (found ? names : "none") << "\n";
+            }
+        }
+    }
+    return 0;
+}
+
+// ===================== MEMORY REPORT =====================
+// --memory-report loads the stored data and prints how much memory its
+// passengers, manifest nodes and bookings take as the compact records the
+// stores keep ("After") and as the Passenger and Booking structs they were
+// stored as before ("Before"). Both count the heap buffers of the strings a
+// record owns. Nothing is written.
+
+// Bytes a string owns outside itself; short strings live in the object
+size_t heapBytes(const string& text) {
+    return text.capacity() > string().capacity() ? text.capacity() + 1 : 0;
+}
+
+void printMemoryRow(const char* label, const MemoryTally& tally) {
+    size_t perBefore = tally.count ? tally.before / tally.count : tally.recordBefore;
+    size_t perAfter = tally.count ? tally.after / tally.count : tally.recordAfter;
+    cout << left << setw(16) << label << right << setw(10) << tally.count
+         << setw(12) << perBefore << setw(12) << perAfter
+         << setw(14) << tally.before << setw(14) << tally.after << "\n";
+}
+
+int runMemoryReport() {
+    // A Passenger used to carry its manifest links in the registry too
+    const size_t linkedPassenger = sizeof(Passenger) + 2 * sizeof(Passenger*);
+    auto passengerHeap = [](const Passenger& p) {
+        return heapBytes(p.name) + heapBytes(p.passport) + heapBytes(p.id) + heapBytes(p.contact) +
+               heapBytes(p.seatNumber) + heapBytes(p.destination);
+    };
+
+    MemoryTally registry{linkedPassenger, sizeof(CompactPassenger)};
+    for (const auto& p : passengers) {
+        registry.count++;
+        registry.before += linkedPassenger + passengerHeap(unpackPassenger(p));
+        registry.after += sizeof(CompactPassenger);
+    }
+
+    MemoryTally manifest{linkedPassenger, sizeof(ManifestNode)};
+    for (const auto& f : catalog.details) {
+        for (const ManifestNode* node = f.passengerHead; node; node = node->next) {
+            Passenger p = unpackPassenger(node->passenger);
+            p.seatNumber = seatCodeToString(node->seat);
+            manifest.count++;
+            manifest.before += linkedPassenger + passengerHeap(p);
+            manifest.after += sizeof(ManifestNode);
+        }
+    }
 
-        };
+    MemoryTally stored{sizeof(Booking), sizeof(CompactBooking)};
+    for (const auto& b : bookings) {
+        if (!b.number) continue;
+        Booking wide = unpackBooking(b);
+        stored.count++;
+        stored.before += sizeof(Booking) + heapBytes(wide.bookingId) + heapBytes(wide.flightNo) +
+                         heapBytes(wide.passengerId) + heapBytes(wide.seatNumber);
+        stored.after += sizeof(CompactBooking);
+    }
 
-        for (auto& flight : flights) {
+    cout << "===== MEMORY REPORT =====\n";
+    cout << left << setw(16) << "Record" << right << setw(10) << "Count"
+         << setw(12) << "Before/rec" << setw(12) << "After/rec"
+         << setw(14) << "Before total" << setw(14) << "After total" << "\n";
+    printMemoryRow("Passenger", registry);
+    printMemoryRow("Manifest node", manifest);
+    printMemoryRow("Booking", stored);
+
+    // Every booking also registers its passenger and adds a manifest node
+    size_t perBookingBefore = registry.recordBefore + manifest.recordBefore + stored.recordBefore;
+    size_t perBookingAfter = registry.recordAfter + manifest.recordAfter + stored.recordAfter;
+    cout << "\nPer booking, without string buffers: " << perBookingBefore << " -> "
+         << perBookingAfter << " bytes\n";
+    cout << "1,000,000 bookings: " << perBookingBefore * 1000000 / (1 << 20) << " MiB -> "
+         << perBookingAfter * 1000000 / (1 << 20) << " MiB\n";
+
+    // Flight numbers and destinations are shared through the symbol table
+    size_t symbolCount, symbolBytes = 0;
+    {
+        lock_guard<mutex> guard(symbols.lock);
+        symbolCount = symbols.names.size();
+        for (const auto& name : symbols.names) symbolBytes += sizeof(string) + heapBytes(name);
+    }
+    cout << "Symbol table: " << symbolCount << " strings, " << symbolBytes << " bytes\n";
 
-            initializeSeats(flight);
+    // What a catalog scan reads per flight, against the whole record it used to walk
+    size_t hotBytes = sizeof(Symbol) * 2 + sizeof(int32_t) + sizeof(float);
+    cout << "Flight catalog: " << catalog.size() << " flights, scans read " << hotBytes
+         << " bytes/flight of hot columns (cold record: " << sizeof(Flight) << " bytes)\n";
+    return 0;
+}
 
+// ===================== MAIN FUNCTION =====================
+// --format text|binary selects the snapshot format checkpoints write
+// (default: the format already on disk). --convert text|binary rewrites the
+// stored data in that format and exits. --batch <file|-> runs commands
+// without the menus (see BATCH MODE). --benchmark <threads> measures booking
+// throughput, --seat-stress <threads> seat claim contention,
+// --layout-benchmark the compile-time seat layouts and
+// --allocation-benchmark seat allocation (see BENCHMARK). --memory-report
+// prints what the stored records take up (see MEMORY REPORT).
+int main(int argc, char* argv[]) {
+    bool formatGiven = false;
+    bool convert = false;
+    string batchPath;
+    int benchmarkThreads = 0;
+    int stressThreads = 0;
+    bool memoryReport = false;
+    bool layoutBenchmark = false;
+    bool allocationBenchmark = false;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if ((option == "--format" || option == "--convert") && i + 1 < argc &&
+            parseFormat(argv[i + 1], snapshotFormat)) {
+            formatGiven = true;
+            convert = convert || option == "--convert";
+            i++;
+        } else if (option == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (option == "--benchmark" && i + 1 < argc &&
+                   parseNumber(string_view(argv[i + 1]), benchmarkThreads) && benchmarkThreads > 0) {
+            i++;
+        } else if (option == "--seat-stress" && i + 1 < argc &&
+                   parseNumber(string_view(argv[i + 1]), stressThreads) && stressThreads > 0) {
+            i++;
+        } else if (option == "--layout-benchmark") {
+            layoutBenchmark = true;
+        } else if (option == "--allocation-benchmark") {
+            allocationBenchmark = true;
+        } else if (option == "--memory-report") {
+            memoryReport = true;
+        } else {
+            cout << "Usage: " << argv[0] << " [--format text|binary] [--convert text|binary]"
+                 << " [--batch file|-] [--benchmark threads] [--seat-stress threads]"
+                 << " [--layout-benchmark] [--allocation-benchmark] [--memory-report]\n";
+            return 1;
         }
     }
-    loadData();
+
+    if (benchmarkThreads > 0) return runBenchmark(benchmarkThreads);
+    if (stressThreads > 0) return runSeatStress(stressThreads);
+    if (layoutBenchmark) return runLayoutBenchmark();
+    if (allocationBenchmark) return runAllocationBenchmark();
+
+    if (catalog.size() == 0) {
+        addFlightToCatalog({intern("AF101"), intern("Cairo"), "Mon 08:00 AM", "1200 km", intern("Boeing 737"), "2h",
+                            standardSeatCount("Boeing 737"), 2500.00f});
+        addFlightToCatalog({intern("AF202"), intern("Nairobi"), "Tue 10:30 AM", "1800 km", intern("Airbus A320"), "3h",
+                            standardSeatCount("Airbus A320"), 3000.00f});
+    }
+    recoverCheckpoint();
+    if (!formatGiven) snapshotFormat = readCheckpointMarker().format;
+
+    // Saving on exit would overwrite the unreadable files with partial state
+    if (!loadData()) return 1;
+    if (memoryReport) return runMemoryReport();
+
+    try {
+
+        openJournal();
+
+    } catch (const exception& e) {
+
+        cout << "Error opening journal: " << e.what() << "\n";
+
+    }
+    if (convert) {
+        saveData();
+        cout << "Data converted to " << formatName(snapshotFormat) << " format.\n";
+        return 0;
+    }
+    startCheckpointer();
+
+    if (!batchPath.empty()) {
+        ios::sync_with_stdio(false);
+        int status = runBatch(batchPath);
+
+        stopCheckpointer();
+        saveData();
+        return status;
+    }
 
     int choice;
     do {
@@ -1681,39 +6367,11 @@ int main() {
     } while (choice != 4);
 
     
-    for (auto& flight : flights) {
-        Passenger* current = flight.passengerHead;
-        while (current) {
-            Passenger* temp = current;
-            current = current->next;
-            delete temp;
-        }
-          flight.passengerHead = nullptr;
-
-    }
-
-    try {
-
-        saveData();
+    stopCheckpointer();
 
-    } catch (const exception& e) {
-
-        cout << "Error saving data: " << e.what() << "\n";
+    saveData();
 
-    }
 
     return 0;
   
 }
-
-
-
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Runs each tests/*.batch through --batch in a fresh directory and compares
+# what it prints with the matching .expected file. A tests/<name>.setup
+# script, if there is one, is sourced in that directory first (with $binary
+# and $tests set) to seed files, run earlier batches or set limits.
+# Usage: tests/run.sh <airline binary>
+binary=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+tests=$(cd "$(dirname "$0")" && pwd)
+failed=0
+for batch in "$tests"/*.batch; do
+    name=$(basename "$batch" .batch)
+    work=$(mktemp -d)
+    if (cd "$work" && { [ ! -f "$tests/$name.setup" ] || . "$tests/$name.setup" >/dev/null 2>&1; } &&
+        "$binary" --batch "$batch" 2>/dev/null) | diff -u "$tests/$name.expected" - ; then
+        echo "PASS $name"
+    else
+        echo "FAIL $name"
+        failed=1
+    fi
+    rm -rf "$work"
+done
+exit $failed